@@ -0,0 +1,368 @@
+//=========================================================================================================//
+//cair-bench - times the stages of CAIR, and whole resizes, over a synthetic set of images.
+//Results go to stdout as JSON, progress goes to stderr.
+//
+//Usage: cair-bench [-s WIDTHxHEIGHT]... [-t THREADS]... [-r MIN_REPS]
+//Defaults are 320x240, 800x600 and 1920x1080, with 1, 2 and 4 threads.
+//=========================================================================================================//
+
+//The stages aren't part of the public interface, so the backend is built right into the benchmark.
+#include "../cair/CAIR.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+//=========================================================================================================//
+//Wall clock seconds, since the stages run on several threads.
+double Now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter( &count );
+	QueryPerformanceFrequency( &frequency );
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+	timeval time;
+	gettimeofday( &time, NULL );
+	return time.tv_sec + time.tv_usec * 1e-6;
+#endif
+}
+
+//=========================================================================================================//
+//Collects the samples for one measurement.
+struct Bench_Timer
+{
+	double start;
+	double total;
+	double best;
+	int samples;
+
+	Bench_Timer()
+	{
+		total = 0;
+		best = 1e30;
+		samples = 0;
+	}
+
+	inline void Start()
+	{
+		start = Now();
+	}
+
+	inline void Stop()
+	{
+		double elapsed = Now() - start;
+		total += elapsed;
+		best = MIN( best, elapsed );
+		samples++;
+	}
+};
+
+//=========================================================================================================//
+//Where the results go. Every record is one line of the "results" array.
+bool first_result = true;
+
+void Report( const char * stage, const char * variant, const char * image, int width, int height, int threads, Bench_Timer * timer )
+{
+	printf( "%s\n    { \"stage\": \"%s\", \"variant\": \"%s\", \"image\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, "
+			"\"reps\": %d, \"mean_ms\": %.4f, \"min_ms\": %.4f }",
+			first_result ? "" : ",", stage, variant, image, width, height, threads,
+			(*timer).samples, 1000.0 * (*timer).total / MAX( (*timer).samples, 1 ), 1000.0 * (*timer).best );
+	first_result = false;
+	fflush( stdout );
+}
+
+//=========================================================================================================//
+//The synthetic corpus. "blocks" is a noisy checkerboard with lots of strong edges, "smooth" is soft gradients with a few
+//hard objects in it, closer to a photo.
+const int corpus_size = 2;
+const char * corpus_names[corpus_size] = { "blocks", "smooth" };
+
+void Make_Image( int which, int width, int height, CML_color * Image )
+{
+	(*Image).D_Resize( width, height );
+	unsigned int seed = 5;
+
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			CML_RGBA pixel;
+			if( which == 0 )
+			{
+				pixel.red = (CML_byte)( ((x/9 + y/7) & 1) * 100 + (seed >> 24) % 60 );
+				pixel.green = (CML_byte)( x*5 + (seed >> 16) % 30 );
+				pixel.blue = (CML_byte)( y*9 );
+			}
+			else
+			{
+				bool object = ( (x - width/3) * (x - width/3) + (y - height/2) * (y - height/2) < (height/5) * (height/5) ) ||
+							  ( (x > width*2/3) && (x < width*3/4) && (y > height/4) );
+				pixel.red = (CML_byte)( object ? 220 : (x * 200) / width + (seed >> 28) );
+				pixel.green = (CML_byte)( object ? 40 : (y * 180) / height + (seed >> 28) );
+				pixel.blue = (CML_byte)( object ? 60 : 120 + (seed >> 29) );
+			}
+			pixel.alpha = 255;
+			(*Image)(x,y) = pixel;
+		}
+	}
+}
+
+//=========================================================================================================//
+//Fill a CML_image from Image with zero weights, ready for the stages.
+void Make_CML_Image( CML_color * Image, CML_image * Dest )
+{
+	CML_int Weights( (*Image).Width(), (*Image).Height() );
+	Weights.Fill( 0 );
+	Init_CML_Image( Image, &Weights, Dest );
+}
+
+//=========================================================================================================//
+//Time every stage for one image at one thread count.
+void Bench_Image( int which, int width, int height, int threads, int min_reps )
+{
+	const char * name = corpus_names[which];
+	CAIR_Context * context = CAIR_Create_Context( threads );
+	Startup_Threads( context );
+
+	CML_color Image( 1, 1 );
+	Make_Image( which, width, height, &Image );
+
+	//keep the total time per stage about the same across the sizes
+	int reps = MAX( min_reps, (int)( 20.0e6 / ((double)width * height) ) );
+	int seam_reps = MIN( reps * 4, width / 4 ); //these ones shrink the image as they go
+
+	CML_image Source( 1, 1 );
+	Make_CML_Image( &Image, &Source );
+
+	fprintf( stderr, "%s %dx%d, %d threads\n", name, width, height, threads );
+
+	//grayscale
+	Bench_Timer gray;
+	for( int i = 0; i < reps; i++ )
+	{
+		gray.Start();
+		Grayscale_Image( context, &Source );
+		gray.Stop();
+	}
+	Report( "Grayscale_Image", "", name, width, height, threads, &gray );
+
+	//edge detection, for every kernel
+	const char * conv_names[5] = { "PREWITT", "V1", "V_SQUARE", "SOBEL", "LAPLACIAN" };
+	for( int conv = PREWITT; conv <= LAPLACIAN; conv++ )
+	{
+		Bench_Timer edge;
+		for( int i = 0; i < reps; i++ )
+		{
+			edge.Start();
+			Edge_Detect( context, &Source, (CAIR_convolution)conv );
+			edge.Stop();
+		}
+		Report( "Edge_Detect", conv_names[conv], name, width, height, threads, &edge );
+	}
+
+	const char * ener_names[2] = { "BACKWARD", "FORWARD" };
+	for( int ener = BACKWARD; ener <= FORWARD; ener++ )
+	{
+		//full energy maps
+		Make_CML_Image( &Image, &Source );
+		Grayscale_Image( context, &Source );
+		Edge_Detect( context, &Source, V1 );
+
+		Bench_Timer full;
+		for( int i = 0; i < reps; i++ )
+		{
+			full.Start();
+			Energy_Map( context, &Source, (CAIR_energy)ener, NULL, false );
+			full.Stop();
+		}
+		Report( "Energy_Map", ener == BACKWARD ? "BACKWARD full" : "FORWARD full", name, width, height, threads, &full );
+
+		//following a seam through the map
+		int * Path = Scratch_Path( context, 0, height );
+		Bench_Timer path;
+		for( int i = 0; i < reps; i++ )
+		{
+			path.Start();
+			Least_Path( &Source.energy, Path );
+			path.Stop();
+		}
+		Report( "Generate_Path", ener_names[ener], name, width, height, threads, &path );
+
+		//seam removal, and the map update after it, the way CAIR_Remove() does them
+		Bench_Timer remove, incremental;
+		for( int i = 0; i < seam_reps; i++ )
+		{
+			remove.Start();
+			Remove_Path( context, &Source, Path, V1 );
+			remove.Stop();
+
+			incremental.Start();
+			Energy_Map( context, &Source, (CAIR_energy)ener, Path, false );
+			incremental.Stop();
+
+			Least_Path( &Source.energy, Path );
+		}
+		Report( "Remove_Path", ener_names[ener], name, width, height, threads, &remove );
+		Report( "Energy_Map", ener == BACKWARD ? "BACKWARD incremental" : "FORWARD incremental", name, width, height, threads, &incremental );
+	}
+
+	//enlarging by 10%, once the seams are known
+	{
+		int adds = MAX( width / 10, 1 );
+		CML_image Resize_img( 1, 1 );
+		Make_CML_Image( &Image, &Resize_img );
+		Resize_img.Track_Removed();
+		CAIR_Remove( context, &Resize_img, width - adds, V1, BACKWARD, NULL, adds, 0 );
+
+		Bench_Timer add;
+		for( int i = 0; i < reps; i++ )
+		{
+			Make_CML_Image( &Image, &Source );
+			add.Start();
+			Add_Path( context, &Resize_img, &Source, width + adds );
+			add.Stop();
+		}
+		Report( "Add_Path", "10%", name, width, height, threads, &add );
+	}
+
+	//transposing the image
+	{
+		CML_color Transposed( 1, 1 );
+		Bench_Timer transpose;
+		for( int i = 0; i < reps; i++ )
+		{
+			transpose.Start();
+			Transposed.Transpose( &Image );
+			transpose.Stop();
+		}
+		Report( "CML_Matrix::Transpose", "CML_color", name, width, height, threads, &transpose );
+	}
+
+	//whole resizes, 10% off each way
+	{
+		CML_int Weights( width, height );
+		Weights.Fill( 0 );
+		CML_int D_Weights( 1, 1 );
+		CML_color Dest( 1, 1 );
+		int goal_x = width - width / 10;
+		int goal_y = height - height / 10;
+		int resize_reps = MAX( min_reps, reps / 20 );
+
+		Bench_Timer cair, hd, removal;
+		for( int i = 0; i < resize_reps; i++ )
+		{
+			cair.Start();
+			CAIR( context, &Image, &Weights, goal_x, goal_y, V1, FORWARD, &D_Weights, &Dest, NULL );
+			cair.Stop();
+		}
+		Report( "CAIR", "V1 FORWARD -10%", name, width, height, threads, &cair );
+
+		for( int i = 0; i < resize_reps; i++ )
+		{
+			hd.Start();
+			CAIR_HD( context, &Image, &Weights, goal_x, goal_y, V1, FORWARD, &D_Weights, &Dest, NULL );
+			hd.Stop();
+		}
+		Report( "CAIR_HD", "V1 FORWARD -10%", name, width, height, threads, &hd );
+
+		//take out a block in the middle
+		for( int y = height/3; y < height/2; y++ )
+		{
+			for( int x = width/3; x < width/3 + width/20 + 1; x++ )
+			{
+				Weights(x,y) = -100000;
+			}
+		}
+		for( int i = 0; i < resize_reps; i++ )
+		{
+			removal.Start();
+			CAIR_Removal( context, &Image, &Weights, AUTO, 1, V1, FORWARD, &D_Weights, &Dest, NULL );
+			removal.Stop();
+		}
+		Report( "CAIR_Removal", "V1 FORWARD AUTO", name, width, height, threads, &removal );
+	}
+
+	CAIR_Destroy_Context( context );
+}
+
+//=========================================================================================================//
+int main( int argc, char * argv[] )
+{
+	int sizes[16][2];
+	int size_count = 0;
+	int threads[16];
+	int thread_count = 0;
+	int min_reps = 3;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( (std::strcmp( argv[i], "-s" ) == 0) && (i + 1 < argc) && (size_count < 16) )
+		{
+			if( sscanf( argv[++i], "%dx%d", &sizes[size_count][0], &sizes[size_count][1] ) == 2 &&
+				(sizes[size_count][0] >= 16) && (sizes[size_count][1] >= 16) )
+			{
+				size_count++;
+			}
+		}
+		else if( (std::strcmp( argv[i], "-t" ) == 0) && (i + 1 < argc) && (thread_count < 16) )
+		{
+			int count = atoi( argv[++i] ); //MAX() is a macro, so don't put the ++i in it
+			threads[thread_count] = MAX( count, 1 );
+			thread_count++;
+		}
+		else if( (std::strcmp( argv[i], "-r" ) == 0) && (i + 1 < argc) )
+		{
+			int reps = atoi( argv[++i] );
+			min_reps = MAX( reps, 1 );
+		}
+		else
+		{
+			fprintf( stderr, "Usage: %s [-s WIDTHxHEIGHT]... [-t THREADS]... [-r MIN_REPS]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	if( size_count == 0 )
+	{
+		int defaults[3][2] = { { 320, 240 }, { 800, 600 }, { 1920, 1080 } };
+		for( size_count = 0; size_count < 3; size_count++ )
+		{
+			sizes[size_count][0] = defaults[size_count][0];
+			sizes[size_count][1] = defaults[size_count][1];
+		}
+	}
+	if( thread_count == 0 )
+	{
+		threads[0] = 1;
+		threads[1] = 2;
+		threads[2] = 4;
+		thread_count = 3;
+	}
+
+	//the kernels CAIR picked for this CPU, or the ones CAIR_SIMD asked for
+	const char * simd = CAIR_SIMD_Name( CAIR_Get_SIMD() );
+
+	printf( "{\n  \"benchmark\": \"cair-bench\",\n  \"cair\": \"2.20\",\n  \"simd\": \"%s\",\n  \"results\": [", simd );
+	for( int s = 0; s < size_count; s++ )
+	{
+		for( int t = 0; t < thread_count; t++ )
+		{
+			for( int image = 0; image < corpus_size; image++ )
+			{
+				Bench_Image( image, sizes[s][0], sizes[s][1], threads[t], min_reps );
+			}
+		}
+	}
+	printf( "\n  ]\n}\n" );
+
+	return 0;
+}
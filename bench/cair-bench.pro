@@ -0,0 +1,31 @@
+# Stage level benchmarks for the CAIR backend. You can make this with
+# qmake cair-bench.pro
+# and run it with
+# ./cair-bench > results.json
+
+TEMPLATE = app
+TARGET = cair-bench
+CONFIG += console release
+CONFIG -= qt app_bundle
+
+#Because the c files have c++ like sytax
+!win32:QMAKE_CC = g++
+
+# cair-bench.cpp includes CAIR.cpp itself, so it can get at the stages
+INCLUDEPATH += ../cair
+
+HEADERS += \
+	   ../cair/CAIR.h \
+	   ../cair/CAIR_CML.h
+
+SOURCES += cair-bench.cpp
+
+win32{
+#use the pthreads lib
+DEFINES += PTHREADS_WINDOWS
+INCLUDEPATH += ../cair/pthreads
+LIBS += ..\cair\pthreads\pthreadVSE2.lib
+}
+!win32{
+LIBS += -lpthread
+}
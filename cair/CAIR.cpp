@@ -27,11 +27,70 @@
 
 //=========================================================================================================//
 //KNOWN BUGS:
-//  - The threading changes in v2.16 lost the reentrant capability of CAIR. (If this hits someone hard, let me know.)
 //  - The percent of completion for the CAIR_callback in CAIR_HD and CAIR_Removal is often wrong.
 
 //=========================================================================================================//
 //CHANGELOG:
+//CAIR v2.20 Changelog:
+//  - CAIR is reentrant again. All threads, semaphores, and scratch buffers now live in a CAIR_Context, which can be handed to
+//    CAIR(), CAIR_HD(), CAIR_Removal(), and the image helpers. Separate contexts can process separate images at the same time.
+//    The old functions without a context use a shared default context.
+//  - CAIR_HD() no longer leaves its threads running when no resize is needed.
+//  - The four sets of threads (gray, edge, remove, add) are replaced by one pool of worker threads per context. The pool is started
+//    the first time it's needed and stays around between calls, so small images don't pay for thread creation every time.
+//    Each thread has its own start semaphore, which fixes a race where one thread could grab two strips of the image.
+//  - The CML_element/CML_image_ptr pair is gone. CML_image now keeps the image, grayscale, edge, weight, and energy in separate planes,
+//    so each stage only touches the data it needs. Seam removal shifts every plane, and CAIR_Add() tracks removed pixels by column.
+//  - CML_Matrix now lives in one 64-byte aligned block with padded rows (see Stride() and Row()), instead of one allocation per row.
+//    Large matrices can ask for transparent huge pages on Linux (define CML_HUGEPAGES), and destructive resizes reuse the block when it fits.
+//  - Edge_Detect() now picks the kernel once per strip through the Convolve_Rows() template, and runs the middle of every row through
+//    SSE2 (or AVX2, when compiled for it) versions of the kernels. The results are exactly the same as Convolve_Pixel().
+//  - Energy_Map() fills each row through Energy_Row(), which does the backward and forward recurrences 4 (SSE2) or 8 (AVX2) pixels
+//    at a time, for both the full map and the trimmed update region. Forward_CostL/U/R() were folded into it.
+//  - Full energy maps of big images (CAIR_PARALLEL_ENERGY pixels) are threaded again, see Energy_Map_Parallel(). Each thread does
+//    a trapezoid of its own columns for CAIR_ENERGY_BLOCK rows, then the gaps between them, so there are only two syncs per block.
+//  - Added CAIR_Seams(), an opt-in mode where CAIR_Remove() takes several non-overlapping seams from one energy map (Energy_Paths())
+//    and removes them all in a single pass (Remove_Paths()). Added CAIR_PSNR() to measure how far that drifts from one seam at a time.
+//  - CAIR_HD() no longer transposes the image after every seam. Horizontal seams are found and removed on the untransposed image
+//    through a CML_Transposed view (Energy_H_Path(), Remove_H_Path()). CML_Matrix::Transpose() now works in cache sized tiles,
+//    and CML_image::Transpose() only moves the image and weights, since everything else is rebuilt anyway.
+//  - CAIR_HD() keeps both energy maps between seams (CML_image::h_energy holds the horizontal one). The map in the direction just
+//    removed is updated around the seam, keeping one more column with forward energy so it is exact, and the other only
+//    recalculates from where the seam started (Energy_Map_Rows()).
+//  - CAIR_Image_Map() and CAIR_Map_Resize() are back, for content-aware multi-size images. The map is now the removal tracking
+//    CAIR_Add() already used (CML_image::removed holds the width each pixel went at), and can have a horizontal half too.
+//  - Added CAIR_Save_Map() and CAIR_Load_Map() for keeping those maps in a versioned file next to the image.
+//  - Added CAIR_Collect_Stats(), which adds up the time spent in each stage, the energy map work saved by the incremental
+//    updates, the time lost to thread syncs, and the peak memory, into a CAIR_Stats.
+//  - CML_Matrix::Attach() lets a matrix work on memory it doesn't own, like the pixels of a QImage, so Source can be read and
+//    Dest written where they already are, without copying them in and out. CAIR_HD() finishes off through a temporary, so an
+//    attached Dest gets the result too.
+//  - Grayscale_Pixel() is all integer now, with the same results as before, and Grayscale_Image() does 8 pixels at a time with SSE2.
+//    The luma weights can be changed at compile time (CAIR_LUMA_BT709, or CAIR_LUMA_R/G/B).
+//  - Remove_Path() and Remove_H_Path() sync with the threads once per seam instead of twice. Each strip rebuilds its own edges right
+//    after its removal, and only the rows where the strips meet are left for afterwards. Images under CAIR_SERIAL_REMOVE pixels skip
+//    the threads altogether.
+//  - Seam removal closes each row's gap from whichever side is shorter (CML_Matrix::Remove_From_Row()), so a row can start a few
+//    elements into its stride. That halves the copying per seam. CML_Matrix::Compact() puts the rows back before the matrix grows.
+//    Rows are still closed up after every seam rather than left with holes to compact every so many seams: the edge, energy and
+//    SIMD code all walk rows as plain arrays, and would have to skip the holes on every pixel. Removing several seams per energy map
+//    (CAIR_Seams()) is what compacts once for many seams (CML_Matrix::Remove_Columns()).
+//  - CAIR_Add() hands Source's planes to the image it shrinks to find the seams (CML_Matrix::Swap()) instead of building a second
+//    image, and copies the originals once, into rows that are already the enlarged width. Add_Path() then inserts the new pixels in
+//    place, filling each row from its end. The separate enlarged image, and the copy back into it before enlarging, are gone. The
+//    removal that finds the seams is still a full one on its own copy, since it blends the pixels it takes into their neighbors.
+//  - CAIR_Removal() runs all its attempts on one internal image instead of calling CAIR() for each. The grayscale and edges carry
+//    over between attempts in the same direction, and so does the energy map with backward energy. It stops as soon as no negative
+//    weights are left. Enlarging back still searches the shrunken image for its seams rather than reusing the removed ones, which
+//    would put the new pixels where the object was, and the update between attempts isn't exact with forward energy.
+//  - Added CAIR_Removal_Band(), which has CAIR_Removal() build its energy maps (Energy_Band_Map()) and find its seams only in a band
+//    around the marked area (Remove_Band_Seams()), widening it when the best seam runs along its edge.
+//  - The AVX2 (and new AVX-512 energy) kernels are always built, and picked at run time from what the CPU has (SIMD_Level()), so one
+//    binary runs everywhere without -mavx2. The CAIR_SIMD environment variable or CAIR_Set_SIMD() can force a lower level, down to scalar.
+//    The level is picked once (pthread_once()) and kept in a std::atomic, so contexts on different threads can share it.
+//  - Fixed reads past the row in Energy_Map() and Energy_Span() on one column images, and Edge_Detect() giving threads rows past the
+//    bottom of images shorter than the thread count. Both turned up under test/cair-test, which checks every SIMD level and thread
+//    count against a frozen copy of the original CAIR on random images (make check).
 //CAIR v2.19 Changelog:
 //  - Single-threaded Energy_Map(), which surprisingly gave a 35% speed boost. My attempts at multithreading this function became a bottleneck.
 //    If anyone has any idea on how to successfully multithread this algorithm, please let me know.
@@ -188,8 +247,47 @@
 #include "CAIR_CML.h"
 #include <cmath> //for abs(), floor()
 #include <limits> //for max int
+#include <algorithm> //for sort()
+#include <cstdio> //for the map files
+#include <cstdlib> //for getenv()
+#include <cstring> //for strcmp()
+#include <atomic> //for the SIMD level
 #include <pthread.h>
 
+//wall clock for CAIR_Stats
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+//SIMD kernels. SSE2 is always there on x86-64. The AVX2 and AVX-512 kernels get built without any special compiler flags, each
+//one marked with the instructions it needs (CAIR_TARGET_AVX2/AVX512), and are only run on CPUs that have them, see SIMD_Level().
+//Define CAIR_NO_AVX for compilers too old to know about them.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAIR_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(CAIR_SSE2) && defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(CAIR_SSE2) && !defined(CAIR_NO_AVX) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CAIR_AVX2
+#define CAIR_AVX512
+#include <immintrin.h>
+#endif
+#if defined(CAIR_AVX2) && defined(__GNUC__)
+#define CAIR_TARGET_AVX2 __attribute__((target("avx2")))
+#define CAIR_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define CAIR_TARGET_AVX2
+#define CAIR_TARGET_AVX512
+#endif
+#if defined(CAIR_AVX2) && defined(_MSC_VER)
+#include <intrin.h> //for __cpuid(), _xgetbv()
+#endif
+
 #ifdef __APPLE__
 #include <mach/semaphore.h>
 #include <mach/task.h>
@@ -243,36 +341,203 @@ void _sem_destroy(void * semStructure)
 using namespace std;
 
 //=========================================================================================================//
-//an image processing element
-struct CML_element
+#define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
+#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+
+//=========================================================================================================//
+//an image being processed
+//Each value CAIR keeps for a pixel lives in its own plane, so every stage only streams through the bytes it actually needs.
+//When a seam is removed, all the planes are shifted together, so (x,y) is always the same pixel in every plane.
+//Fill one in with Init_CML_Image(), and after the resizes are done pull the image and weights back out with Extract_CML_Image().
+struct CML_image
 {
-	CML_RGBA image; //standard image pixel value
-	int edge;       //the edge value of the pixel
-	int weight;     //its associated weight
-	int energy;     //the calculated energy for this pixel
-	CML_byte gray;  //its grayscale value
-	bool removed;   //flag telling me if the pixel was removed during a resize
+	CML_image( int x, int y );
+
+	CML_color image; //standard image pixel values
+	CML_gray gray;   //grayscale values
+	CML_int edge;    //edge values
+	CML_int weight;  //associated weights
+	CML_int energy;  //calculated energy
+
+	//When track_removed is set, column holds the original column of every pixel, and removed holds (in the original
+	//coordinates) the width the image had when a seam took that pixel out, or 0 if it is still there. CAIR_Add() uses
+	//this to know where to insert its seams, and it is the map made by CAIR_Image_Map().
+	bool track_removed;
+	CML_int column;
+	CML_int removed;
+
+	//When track_h_energy is set, h_energy holds the energy map for horizontal seams (in transposed coordinates, like
+	//a CML_Transposed view would see it) and follows the resizes. CAIR_HD() keeps both maps this way.
+	bool track_h_energy;
+	CML_int h_energy;
+
+	inline int Width()
+	{
+		return image.Width();
+	}
+	inline int Height()
+	{
+		return image.Height();
+	}
+
+	void D_Resize( int x, int y );
+	void Resize_Width( int x );
+	void Resize_Height( int y );
+	void Remove_From_Row( int x, int y, int width );
+	void Remove_Columns( int y, int * columns, int count );
+	void Transpose( CML_image * Source );
+	void Track_Removed();
+	void Track_H_Energy();
+	size_t Bytes();
 };
-//an image being processed
-typedef CML_Matrix<CML_element> CML_image;
-//ok, now we have a single structure of all the info for a give pixel that we'll need.
-//now, we create a matrix of pointers. when we remove a seam, shift this matrix. access all elements through this matrix.
-//first, though, you'll need to fill in a CML_image, then set all the pointers in a CML_image_ptr. After the resizes are done,
-//you'll need to pull the image and weights back out. See Init_CML_Image() and Extract_CML_Image()
-typedef CML_Matrix<CML_element *> CML_image_ptr;
+
+CML_image::CML_image( int x, int y ) : image( x, y ), gray( x, y ), edge( x, y ), weight( x, y ), energy( x, y ), column( 1, 1 ), removed( 1, 1 ), h_energy( 1, 1 )
+{
+	track_removed = false;
+	track_h_energy = false;
+}
+
+//=========================================================================================================//
+//Destructive resize of every plane.
+void CML_image::D_Resize( int x, int y )
+{
+	image.D_Resize( x, y );
+	gray.D_Resize( x, y );
+	edge.D_Resize( x, y );
+	weight.D_Resize( x, y );
+	energy.D_Resize( x, y );
+	track_removed = false;
+	track_h_energy = false;
+}
+
+//=========================================================================================================//
+//Non-destructive resize of every plane, see CML_Matrix::Resize_Width().
+void CML_image::Resize_Width( int x )
+{
+	image.Resize_Width( x );
+	gray.Resize_Width( x );
+	edge.Resize_Width( x );
+	weight.Resize_Width( x );
+	energy.Resize_Width( x );
+	if( track_removed == true )
+	{
+		column.Resize_Width( x );
+	}
+	if( track_h_energy == true )
+	{
+		h_energy.Resize_Height( x );
+	}
+}
+
+//=========================================================================================================//
+//Non-destructive shrink of every plane, see CML_Matrix::Resize_Height().
+void CML_image::Resize_Height( int y )
+{
+	image.Resize_Height( y );
+	gray.Resize_Height( y );
+	edge.Resize_Height( y );
+	weight.Resize_Height( y );
+	energy.Resize_Height( y );
+	if( track_removed == true )
+	{
+		column.Resize_Height( y );
+	}
+	if( track_h_energy == true )
+	{
+		h_energy.Resize_Width( y );
+	}
+}
+
+//=========================================================================================================//
+//Removes pixel x from row y of every plane, see CML_Matrix::Remove_From_Row().
+void CML_image::Remove_From_Row( int x, int y, int width )
+{
+	image.Remove_From_Row( x, y, width );
+	gray.Remove_From_Row( x, y, width );
+	edge.Remove_From_Row( x, y, width );
+	weight.Remove_From_Row( x, y, width );
+	energy.Remove_From_Row( x, y, width );
+	if( track_removed == true )
+	{
+		column.Remove_From_Row( x, y, width );
+	}
+}
+
+//=========================================================================================================//
+//Removes several pixels from row y, see CML_Matrix::Remove_Columns(). The edge and energy are left alone, since they are
+//recalculated in full after a multi-seam removal.
+void CML_image::Remove_Columns( int y, int * columns, int count )
+{
+	image.Remove_Columns( y, columns, count );
+	gray.Remove_Columns( y, columns, count );
+	weight.Remove_Columns( y, columns, count );
+	if( track_removed == true )
+	{
+		column.Remove_Columns( y, columns, count );
+	}
+}
+
+//=========================================================================================================//
+//Does a flip/rotate of Source's image and weights, storing them into ourself.
+//The grayscale, edges, and energy are always rebuilt before they're used, so they only get the right size.
+void CML_image::Transpose( CML_image * Source )
+{
+	image.Transpose( &(*Source).image );
+	weight.Transpose( &(*Source).weight );
+	gray.D_Resize( (*Source).Height(), (*Source).Width() );
+	edge.D_Resize( (*Source).Height(), (*Source).Width() );
+	energy.D_Resize( (*Source).Height(), (*Source).Width() );
+	track_removed = false;
+	track_h_energy = false;
+}
+
+//=========================================================================================================//
+//Start keeping the horizontal seam energy map. Its contents start out undefined.
+void CML_image::Track_H_Energy()
+{
+	h_energy.D_Resize( Height(), Width() );
+	track_h_energy = true;
+}
+
+//=========================================================================================================//
+//Memory held by every plane, see CML_Matrix::Bytes().
+size_t CML_image::Bytes()
+{
+	return image.Bytes() + gray.Bytes() + edge.Bytes() + weight.Bytes() + energy.Bytes() +
+		   column.Bytes() + removed.Bytes() + h_energy.Bytes();
+}
+
+//=========================================================================================================//
+//Start recording which pixels get removed from the current image.
+void CML_image::Track_Removed()
+{
+	column.D_Resize( Width(), Height() );
+	removed.D_Resize( Width(), Height() );
+	removed.Fill( 0 );
+
+	for( int y = 0; y < Height(); y++ )
+	{
+		for( int x = 0; x < Width(); x++ )
+		{
+			column(x,y) = x;
+		}
+	}
+	track_removed = true;
+}
 
 //=========================================================================================================//
 //Thread parameters
 struct Thread_Params
 {
 	//Image Parameters
-	CML_image_ptr * Source;
+	CML_image * Source;
 	CAIR_convolution conv;
 	CAIR_energy ener;
 	//Internal Stuff
 	int * Path;
+	int seams; //number of seams in Path, stored row by row
+	int old_size; //the width (height, for horizontal seams) from before the removal, which has already been resized away
 	CML_image * Add_Resize;
-	CML_image * Add_Source;
 	//Thread Parameters
 	int top_y;
 	int bot_y;
@@ -280,1428 +545,3492 @@ struct Thread_Params
 	int bot_x;
 	bool exit; //flag causing the thread to exit
 	int thread_num;
+	double job_seconds; //how long the last job took, only kept when collecting stats
+	CAIR_Context * context; //the context that owns this thread
+	void (*job)( Thread_Params * ); //the stage the thread should run next
 };
 
 //=========================================================================================================//
-//Thread Info
-Thread_Params * thread_info;
+//Everything a single resize needs that used to be global. Each context has its own threads and semaphores,
+//so two contexts never step on each other.
+struct CAIR_Context
+{
+	CAIR_Context( int thread_count );
+	~CAIR_Context();
 
-//Thread Handles
-pthread_t * remove_threads;
-pthread_t * edge_threads;
-pthread_t * gray_threads;
-pthread_t * add_threads;
-int num_threads = CAIR_NUM_THREADS;
+	//Thread Info
+	Thread_Params * thread_info;
 
-//Thread Semaphores
-SEM_T remove_sem[3]; //start, edge_start, finish
-SEM_T add_sem[3]; //start, build_start, finish
-SEM_T edge_sem[2]; //start, finish
-SEM_T gray_sem[2]; //start, finish
+	//Thread Handles
+	//The pool is started on first use and kept around until the context is destroyed.
+	//Every stage (gray, edge, remove, add) runs on these same threads.
+	pthread_t * threads;
+	int num_threads;     //how many threads we want
+	int running_threads; //how many threads are in the pool right now, zero if it isn't started
 
-//early declarations on the threading functions
-void Startup_Threads();
-void Shutdown_Threads();
+	//Thread Semaphores
+	SEM_T * start_sem; //one per thread, so a fast thread can't run the same job twice
+	SEM_T finish_sem;
 
+	//Scratch seam buffers, kept around so we don't allocate one per seam
+	int * path[2];
+	int path_size[2];
 
-//=========================================================================================================//
-#define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
-#define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
+	//Seams taken from each energy map, see CAIR_Seams()
+	int seams;
+	CML_Matrix<bool> taken; //pixels already used by a seam in the current map, always left all false
 
-//=========================================================================================================//
-//==                                          G R A Y S C A L E                                          ==//
-//=========================================================================================================//
+	//How far past the marked area CAIR_Removal() looks for seams, 0 for the whole image. See CAIR_Removal_Band()
+	int removal_band;
 
-//=========================================================================================================//
-//Performs a RGB->YUV type conversion (we only want Y', the luma)
-inline CML_byte Grayscale_Pixel( CML_RGBA * pixel )
+	//Where to add up the stats, NULL when not collecting them. See CAIR_Collect_Stats()
+	CAIR_Stats * stats;
+	double sync_start; //when Start_Threads() handed out the current job
+};
+
+//early declarations on the threading functions
+void Startup_Threads( CAIR_Context * context );
+void Shutdown_Threads( CAIR_Context * context );
+
+CAIR_Context::CAIR_Context( int thread_count ) : taken( 1, 1 )
 {
-	return (CML_byte)floor( ( 299 * pixel->red +
-							  587 * pixel->green +
-							  114 * pixel->blue ) / 1000.0 );
+	thread_info = NULL;
+	threads = NULL;
+	start_sem = NULL;
+	num_threads = MAX( thread_count, 1 );
+	running_threads = 0;
+
+	path[0] = NULL;
+	path[1] = NULL;
+	path_size[0] = 0;
+	path_size[1] = 0;
+
+	seams = 1;
+	taken.Fill( false );
+	removal_band = 0;
+
+	stats = NULL;
+	sync_start = 0;
 }
 
-//=========================================================================================================//
-//Our thread function for the Grayscale
-void * Gray_Quadrant( void * id )
+CAIR_Context::~CAIR_Context()
 {
-	int num = *((int *)id);
-
-	while( true )
-	{
-		//wait for the thread to get a signal to start
-		_sem_wait( &(gray_sem[0]) );
+	Shutdown_Threads( this );
 
-		//get updated parameters
-		Thread_Params gray_area = thread_info[num];
-
-		if( gray_area.exit == true )
-		{
-			//thread is exiting
-			break;
-		}
+	delete[] path[0];
+	delete[] path[1];
+}
 
-		int width = (*(gray_area.Source)).Width();
-		for( int y = gray_area.top_y; y < gray_area.bot_y; y++ )
-		{
-			for( int x = 0; x < width; x++ )
-			{
-				(*(gray_area.Source))(x,y)->gray = Grayscale_Pixel( &(*(gray_area.Source))(x,y)->image );
-			}
-		}
+//the context used by the functions that don't take one
+CAIR_Context default_context( CAIR_NUM_THREADS );
 
-		//signal we're done
-		_sem_signal( &(gray_sem[1]) );
+//Hand out one of the scratch seam buffers, growing it if the image is taller than last time.
+int * Scratch_Path( CAIR_Context * context, int which, int size )
+{
+	if( context->path_size[which] < size )
+	{
+		delete[] context->path[which];
+		context->path[which] = new int[size];
+		context->path_size[which] = size;
 	}
+	return context->path[which];
+}
 
-	return NULL;
-} //end Gray_Quadrant()
+//=========================================================================================================//
+//==                                              S T A T S                                              ==//
+//=========================================================================================================//
 
 //=========================================================================================================//
-//Sort-of does a RGB->YUV conversion (actually, just RGB->Y)
-//Multi-threaded with each thread getting a strip across the image.
-void Grayscale_Image( CML_image_ptr * Source )
+//Wall clock time in seconds.
+double Stats_Time()
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter( &count );
+	QueryPerformanceFrequency( &frequency );
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+	timeval time;
+	gettimeofday( &time, NULL );
+	return time.tv_sec + time.tv_usec * 1e-6;
+#endif
+}
+
+//=========================================================================================================//
+//Start timing a stage. Only reads the clock when the context is collecting stats.
+inline double Stats_Start( CAIR_Context * context )
 {
-	int thread_height = (*Source).Height() / num_threads;
+	return ( context->stats != NULL ) ? Stats_Time() : 0;
+}
 
-	//setup parameters
-	for( int i = 0; i < num_threads; i++ )
+//Add the time since start to stage.
+inline void Stats_Stop( CAIR_Context * context, CAIR_stage stage, double start )
+{
+	if( context->stats != NULL )
 	{
-		thread_info[i].Source = Source;
-		thread_info[i].top_y = i * thread_height;
-		thread_info[i].bot_y = thread_info[i].top_y + thread_height;
+		context->stats->seconds[stage] += Stats_Time() - start;
 	}
+}
 
-	//have the last thread pick up the slack
-	thread_info[num_threads-1].bot_y = (*Source).Height();
+//Count seams removed or added.
+inline void Stats_Seams( CAIR_Context * context, int seams )
+{
+	if( context->stats != NULL )
+	{
+		context->stats->seams += seams;
+	}
+}
 
-	//startup the threads
-	for( int i = 0; i < num_threads; i++ )
+//Count energy map entries calculated, out of the full map of full_cells.
+inline void Stats_Cells( CAIR_Context * context, long long cells, long long full_cells )
+{
+	if( context->stats != NULL )
 	{
-		_sem_signal( &(gray_sem[0]) );
+		context->stats->energy_cells += cells;
+		context->stats->energy_cells_full += full_cells;
 	}
+}
 
-	//now wait for them to come back to us
-	for( int i = 0; i < num_threads; i++ )
+//Note the memory held by the working images (Second can be NULL) and the context's scratch.
+void Stats_Memory( CAIR_Context * context, CML_image * First, CML_image * Second )
+{
+	if( context->stats == NULL )
 	{
-		_sem_wait( &(gray_sem[1]) );
+		return;
 	}
 
-} //end Grayscale_Image()
+	size_t bytes = (*First).Bytes() + context->taken.Bytes() +
+				   (context->path_size[0] + context->path_size[1]) * sizeof(int);
+	if( Second != NULL )
+	{
+		bytes += (*Second).Bytes();
+	}
+	context->stats->peak_bytes = MAX( context->stats->peak_bytes, bytes );
+}
 
 //=========================================================================================================//
-//==                                                 E D G E                                             ==//
+//==                                             T H R E A D S                                           ==//
 //=========================================================================================================//
-enum edge_safe { SAFE, UNSAFE };
 
 //=========================================================================================================//
-//returns the convolution value of the pixel Source[x][y] with one of the kernels.
-//Several kernels are avaialable, each with their strengths and weaknesses. The edge_safe
-//param will use the slower, but safer Get() method of the CML.
-int Convolve_Pixel( CML_image_ptr * Source, int x, int y, edge_safe safety, CAIR_convolution convolution)
+//Every thread in the pool sits here. It waits for its own start signal, runs the job it was handed, then tells
+//the main thread it's done.
+void * Worker_Thread( void * id )
 {
-	int conv = 0;
+	Thread_Params * info = (Thread_Params *)id;
+	CAIR_Context * context = (*info).context;
+	int num = (*info).thread_num;
 
-	switch( convolution )
+	while( true )
 	{
-	case PREWITT:
-		if( safety == SAFE )
-		{
-			conv = abs( (*Source).Get(x+1,y+1)->gray + (*Source).Get(x+1,y)->gray + (*Source).Get(x+1,y-1)->gray //x part of the prewitt
-					   -(*Source).Get(x-1,y-1)->gray - (*Source).Get(x-1,y)->gray - (*Source).Get(x-1,y+1)->gray ) +
-				   abs( (*Source).Get(x+1,y+1)->gray + (*Source).Get(x,y+1)->gray + (*Source).Get(x-1,y+1)->gray //y part of the prewitt
-					   -(*Source).Get(x+1,y-1)->gray - (*Source).Get(x,y-1)->gray - (*Source).Get(x-1,y-1)->gray );
-		}
-		else
-		{
-			conv = abs( (*Source)(x+1,y+1)->gray + (*Source)(x+1,y)->gray + (*Source)(x+1,y-1)->gray //x part of the prewitt
-					   -(*Source)(x-1,y-1)->gray - (*Source)(x-1,y)->gray - (*Source)(x-1,y+1)->gray ) +
-				   abs( (*Source)(x+1,y+1)->gray + (*Source)(x,y+1)->gray + (*Source)(x-1,y+1)->gray //y part of the prewitt
-					   -(*Source)(x+1,y-1)->gray - (*Source)(x,y-1)->gray - (*Source)(x-1,y-1)->gray );
-		}
-		break;
+		_sem_wait( &(context->start_sem[num]) );
 
-	 case V_SQUARE:
-		if( safety == SAFE )
-		{
-			conv = (*Source).Get(x+1,y+1)->gray + (*Source).Get(x+1,y)->gray + (*Source).Get(x+1,y-1)->gray //x part of the prewitt
-				  -(*Source).Get(x-1,y-1)->gray - (*Source).Get(x-1,y)->gray - (*Source).Get(x-1,y+1)->gray;
-			conv *= conv;
-		}
-		else
+		if( (*info).exit == true )
 		{
-			conv = (*Source)(x+1,y+1)->gray + (*Source)(x+1,y)->gray + (*Source)(x+1,y-1)->gray //x part of the prewitt
-				  -(*Source)(x-1,y-1)->gray - (*Source)(x-1,y)->gray - (*Source)(x-1,y+1)->gray;
-			conv *= conv;
+			//thread is exiting
+			break;
 		}
-		break;
 
-	 case V1:
-		if( safety == SAFE )
-		{
-			conv =  abs( (*Source).Get(x+1,y+1)->gray + (*Source).Get(x+1,y)->gray + (*Source).Get(x+1,y-1)->gray //x part of the prewitt
-						-(*Source).Get(x-1,y-1)->gray - (*Source).Get(x-1,y)->gray - (*Source).Get(x-1,y+1)->gray );
-		}
-		else
-		{
-			conv = abs( (*Source)(x+1,y+1)->gray + (*Source)(x+1,y)->gray + (*Source)(x+1,y-1)->gray //x part of the prewitt
-					   -(*Source)(x-1,y-1)->gray - (*Source)(x-1,y)->gray - (*Source)(x-1,y+1)->gray ) ;
-		}
-		break;
-	
-	 case SOBEL:
-		if( safety == SAFE )
+		if( context->stats != NULL )
 		{
-			conv = abs( (*Source).Get(x+1,y+1)->gray + (2 * (*Source).Get(x+1,y)->gray) + (*Source).Get(x+1,y-1)->gray //x part of the sobel
-					   -(*Source).Get(x-1,y-1)->gray - (2 * (*Source).Get(x-1,y)->gray) - (*Source).Get(x-1,y+1)->gray ) +
-				   abs( (*Source).Get(x+1,y+1)->gray + (2 * (*Source).Get(x,y+1)->gray) + (*Source).Get(x-1,y+1)->gray //y part of the sobel
-					   -(*Source).Get(x+1,y-1)->gray - (2 * (*Source).Get(x,y-1)->gray) - (*Source).Get(x-1,y-1)->gray );
+			double start = Stats_Time();
+			(*info).job( info );
+			(*info).job_seconds = Stats_Time() - start;
 		}
 		else
 		{
-			conv = abs( (*Source)(x+1,y+1)->gray + (2 * (*Source)(x+1,y)->gray) + (*Source)(x+1,y-1)->gray //x part of the sobel
-					   -(*Source)(x-1,y-1)->gray - (2 * (*Source)(x-1,y)->gray) - (*Source)(x-1,y+1)->gray ) +
-				   abs( (*Source)(x+1,y+1)->gray + (2 * (*Source)(x,y+1)->gray) + (*Source)(x-1,y+1)->gray //y part of the sobel
-					   -(*Source)(x+1,y-1)->gray - (2 * (*Source)(x,y-1)->gray) - (*Source)(x-1,y-1)->gray );
+			(*info).job( info );
 		}
-		break;
 
-	case LAPLACIAN:
-		if( safety == SAFE )
-		{
-			conv = abs( (*Source).Get(x+1,y)->gray + (*Source).Get(x-1,y)->gray + (*Source).Get(x,y+1)->gray + (*Source).Get(x,y-1)->gray
-					   -(4 * (*Source).Get(x,y)->gray) );
-		}
-		else
-		{
-			conv = abs( (*Source)(x+1,y)->gray + (*Source)(x-1,y)->gray + (*Source)(x,y+1)->gray + (*Source)(x,y-1)->gray
-					   -(4 * (*Source)(x,y)->gray) );
-		}
-		break;
+		//signal we're done
+		_sem_signal( &(context->finish_sem) );
 	}
-	return conv;
+
+	return NULL;
 }
 
 //=========================================================================================================//
-//The thread function, splitting the image into strips
-void * Edge_Quadrant( void * id )
+//Make sure the pool is running with the requested number of threads. Does nothing if it already is,
+//so every frontend function can just call this first.
+void Startup_Threads( CAIR_Context * context )
 {
-	int num = *((int *)id);
-
-	while( true )
+	if( context->running_threads == context->num_threads )
 	{
-		_sem_wait( &(edge_sem[0]) );
-
-		//get updated parameters
-		Thread_Params edge_area = thread_info[num];
+		return;
+	}
 
-		if( edge_area.exit == true )
-		{
-			//thread is exiting
-			break;
-		}
+	//CAIR_Threads() changed the count since last time
+	Shutdown_Threads( context );
 
-		for( int y = edge_area.top_y; y < edge_area.bot_y; y++ )
-		{
-			//left most edge
-			(*(edge_area.Source))(0,y)->edge = Convolve_Pixel( edge_area.Source, 0, y, SAFE, edge_area.conv );
+	//create semaphores
+	context->start_sem = new SEM_T[context->num_threads];
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		_sem_create( &(context->start_sem[i]), 0 );
+	}
+	_sem_create( &(context->finish_sem), 0 );
 
-			//fill in the middle
-			int width = (*(edge_area.Source)).Width();
-			for( int x = 1; x < width - 1; x++ )
-			{
-				(*(edge_area.Source))(x,y)->edge = Convolve_Pixel( edge_area.Source, x, y, UNSAFE, edge_area.conv );
-			}
+	//create the thread handles
+	context->threads = new pthread_t[context->num_threads];
+	context->thread_info = new Thread_Params[context->num_threads];
 
-			//right most edge
-			(*(edge_area.Source))(width-1,y)->edge = Convolve_Pixel( edge_area.Source, width-1, y, SAFE, edge_area.conv);
-		}
+	//startup the threads
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].exit = false;
+		context->thread_info[i].thread_num = i;
+		context->thread_info[i].context = context;
+		context->thread_info[i].job_seconds = 0;
 
-		//signal we're done
-		_sem_signal( &(edge_sem[1]) );
+		pthread_create( &(context->threads[i]), NULL, Worker_Thread, (void *)(&(context->thread_info[i])) );
 	}
 
-	return NULL;
+	context->running_threads = context->num_threads;
 }
 
 //=========================================================================================================//
-//Performs full edge detection on Source with one of the kernels.
-void Edge_Detect( CML_image_ptr * Source, CAIR_convolution conv )
+//Stops all threads. Deletes all semaphores.
+void Shutdown_Threads( CAIR_Context * context )
 {
-	//There is no easy solution to the boundries. Calling the same boundry pixel to convolve itself against seems actually better
-	//than padding the image with zeros or 255's.
-	//Calling itself induces a "ringing" into the near edge of the image. Padding can lead to a darker or lighter edge.
-	//The only "good" solution is to have the entire one-pixel wide edge not included in the edge detected image.
-	//This would reduce the size of the image by 2 pixels in both directions, something that is unacceptable here.
-
-	int thread_height = (*Source).Height() / num_threads;
-	int height = (*Source).Height();
-	int width = (*Source).Width();
-
-	//setup parameters
-	for( int i = 0; i < num_threads; i++ )
+	if( context->running_threads == 0 )
 	{
-		thread_info[i].Source = Source;
-		thread_info[i].top_y = (i * thread_height) + 1; //handle very top row down below
-		thread_info[i].bot_y = thread_info[i].top_y + thread_height;
-		thread_info[i].conv = conv;
+		return;
 	}
 
-	//have the last thread pick up the slack
-	thread_info[num_threads-1].bot_y = height - 1; //handle very bottom row down below
-
-	//create the threads
-	for( int i = 0; i < num_threads; i++ )
+	//notify the threads and start them up
+	for( int i = 0; i < context->running_threads; i++ )
 	{
-		_sem_signal( &(edge_sem[0]) );
+		context->thread_info[i].exit = true;
+		_sem_signal( &(context->start_sem[i]) );
 	}
 
-	//while those are running we can go back and do the boundry pixels with the extra safety checks
-	for( int x = 0; x < width; x++ )
+	//wait for the joins
+	for( int i = 0; i < context->running_threads; i++ )
 	{
-		(*Source)(x,0)->edge = Convolve_Pixel( Source, x, 0, SAFE, conv );
-		(*Source)(x,height-1)->edge = Convolve_Pixel( Source, x, height-1, SAFE, conv );
+		pthread_join( context->threads[i], NULL );
 	}
 
-	//now wait on them
-	for( int i = 0; i < num_threads; i++ )
+	//delete the semaphores
+	for( int i = 0; i < context->running_threads; i++ )
 	{
-		_sem_wait( &(edge_sem[1]) );
+		_sem_destroy( &(context->start_sem[i]) );
 	}
+	_sem_destroy( &(context->finish_sem) );
 
-} //end Edge_Detect()
-
-//=========================================================================================================//
-//==                                           E N E R G Y                                               ==//
-//=========================================================================================================//
+	//remove the thread handles
+	delete[] context->start_sem;
+	delete[] context->threads;
+	delete[] context->thread_info;
+	context->start_sem = NULL;
+	context->threads = NULL;
+	context->thread_info = NULL;
+
+	context->running_threads = 0;
+}
 
 //=========================================================================================================//
-//Simple fuction returning the minimum of three values.
-//The obvious MIN(MIN(x,y),z) is actually undesirable, since that would guarantee three branch checks.
-//This one here sucks up a variable to guarantee only two branches.
-inline int min_of_three( int x, int y, int z )
+//Hand job to every thread. The thread parameters must be set up beforehand.
+void Start_Threads( CAIR_Context * context, void (*job)( Thread_Params * ) )
 {
-	int min = y;
+	context->sync_start = Stats_Start( context );
 
-	if( x < min )
-	{
-		min = x;
-	}
-	if( z < min )
+	for( int i = 0; i < context->num_threads; i++ )
 	{
-		return z;
+		context->thread_info[i].job = job;
+		_sem_signal( &(context->start_sem[i]) );
 	}
-
-	return min;
 }
 
 //=========================================================================================================//
-//Get the value from the integer matrix, return a large value if out-of-bounds in the x-direction.
-inline int Get_Max( CML_image_ptr * Energy, int x, int y )
+//Wait for every thread to come back from Start_Threads().
+void Wait_Threads( CAIR_Context * context )
 {
-	if( ( x < 0 ) || ( x >= (*Energy).Width() ) )
+	for( int i = 0; i < context->num_threads; i++ )
 	{
-		return std::numeric_limits<int>::max();
+		_sem_wait( &(context->finish_sem) );
 	}
-	else
+
+	//whatever the slowest thread didn't spend working went to waking the threads up and waiting on them
+	if( context->stats != NULL )
 	{
-		return (*Energy)(x,y)->energy;
+		double elapsed = Stats_Time() - context->sync_start;
+		double slowest = 0;
+		double average = 0;
+		for( int i = 0; i < context->num_threads; i++ )
+		{
+			slowest = MAX( slowest, context->thread_info[i].job_seconds );
+			average += context->thread_info[i].job_seconds / context->num_threads;
+		}
+		context->stats->syncs++;
+		context->stats->sync_seconds += MAX( elapsed - slowest, 0.0 );
+		context->stats->imbalance_seconds += slowest - average;
 	}
 }
 
 //=========================================================================================================//
-//This calculates a minimum energy path from the given start point (min_x) and the energy map.
-void Generate_Path( CML_image_ptr * Energy, int min_x, int * Path )
+//Run job on every thread and wait for them to finish.
+void Run_Threads( CAIR_Context * context, void (*job)( Thread_Params * ) )
 {
-	int min;
-	int x = min_x;
+	Start_Threads( context, job );
+	Wait_Threads( context );
+}
 
-	int height = (*Energy).Height();
-	for( int y = height - 1; y >= 0; y-- ) //builds from bottom up
-	{
-		min = x; //assume the minimum is straight up
 
-		if( Get_Max( Energy, x-1, y ) < Get_Max( Energy, min, y ) ) //check to see if min is up-left
-		{
-			min = x - 1;
-		}
-		if( Get_Max( Energy, x+1, y ) < Get_Max( Energy, min, y) ) //up-right
+
+//=========================================================================================================//
+//==                                                 S I M D                                             ==//
+//=========================================================================================================//
+
+//The kernels the stages are using, -1 until SIMD_Level() first looks. It's a property of the CPU, so it's shared by every context,
+//which can be running on any thread. Init_SIMD() fills it in exactly once, through simd_once.
+std::atomic<int> simd_level( -1 );
+pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+//=========================================================================================================//
+//The best kernels this CPU can run.
+CAIR_simd Detect_SIMD()
+{
+	CAIR_simd best = CAIR_SCALAR;
+#ifdef CAIR_SSE2
+	best = CAIR_SIMD_SSE2;
+#endif
+
+#if defined(CAIR_AVX2) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) )
+	{
+		best = CAIR_SIMD_AVX2;
+	}
+	if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "avx512f" ) )
+	{
+		best = CAIR_SIMD_AVX512;
+	}
+#elif defined(CAIR_AVX2) && defined(_MSC_VER)
+	int info[4];
+	__cpuid( info, 0 );
+	if( info[0] >= 7 )
+	{
+		__cpuid( info, 1 );
+		bool os_saves = ( (info[2] & (1 << 27)) != 0 ); //OSXSAVE, so _xgetbv() can be asked
+		__cpuidex( info, 7, 0 );
+		if( os_saves && ((info[1] & (1 << 5)) != 0) && ((_xgetbv( 0 ) & 0x06) == 0x06) )
 		{
-			min = x + 1;
+			best = CAIR_SIMD_AVX2;
+			if( ((info[1] & (1 << 16)) != 0) && ((_xgetbv( 0 ) & 0xE6) == 0xE6) )
+			{
+				best = CAIR_SIMD_AVX512;
+			}
 		}
-		
-		Path[y] = min;
-		x = min;
 	}
+#endif
+	return best;
 }
 
 //=========================================================================================================//
-//Forward energy cost functions. These are additional energy values for the left, up, and right seam paths.
-//See the paper "Improved Seam Carving for Video Retargeting" by Michael Rubinstein, Ariel Shamir, and Shai  Avidan.
-inline int Forward_CostL( CML_image_ptr * Edge, int x, int y )
+//The starting level: the best the CPU has, unless the CAIR_SIMD environment variable asks for less (scalar, sse2, avx2 or avx512).
+//Only ever run through pthread_once().
+void Init_SIMD()
 {
-	return (abs((*Edge)(x+1,y)->edge - (*Edge)(x-1,y)->edge) + abs((*Edge)(x,y-1)->edge - (*Edge)(x-1,y)->edge));
+	CAIR_simd level = Detect_SIMD();
+	const char * wanted = getenv( "CAIR_SIMD" );
+	if( wanted != NULL )
+	{
+		for( int i = CAIR_SCALAR; i <= CAIR_SIMD_AVX512; i++ )
+		{
+			if( strcmp( wanted, CAIR_SIMD_Name( (CAIR_simd)i ) ) == 0 )
+			{
+				level = (CAIR_simd)MIN( i, (int)level );
+			}
+		}
+	}
+	simd_level.store( level );
 }
 
-inline int Forward_CostU( CML_image_ptr * Edge, int x, int y )
+//=========================================================================================================//
+//Which kernels to run. This is asked for every row, so once the level is set it's just the one atomic load.
+inline int SIMD_Level()
 {
-	return (abs((*Edge)(x+1,y)->edge - (*Edge)(x-1,y)->edge));
+	int level = simd_level.load();
+	if( level < 0 )
+	{
+		pthread_once( &simd_once, Init_SIMD );
+		level = simd_level.load();
+	}
+	return level;
 }
 
-inline int Forward_CostR( CML_image_ptr * Edge, int x, int y )
+//=========================================================================================================//
+//==                                          G R A Y S C A L E                                          ==//
+//=========================================================================================================//
+
+#if CAIR_LUMA_R + CAIR_LUMA_G + CAIR_LUMA_B != 1000
+#error The CAIR_LUMA weights must add up to 1000
+#endif
+
+//=========================================================================================================//
+//Performs a RGB->YUV type conversion (we only want Y', the luma)
+//The sum is at most 255000, so the divide by 1000 is done as a divide by 8 and then by 125, with the second one
+//as a multiply and shift. That gives exactly the same floor() as dividing by 1000.0, for every pixel.
+inline CML_byte Grayscale_Pixel( CML_RGBA * pixel )
 {
-	return (abs((*Edge)(x+1,y)->edge - (*Edge)(x-1,y)->edge) + abs((*Edge)(x,y-1)->edge - (*Edge)(x+1,y)->edge));
+	int sum = CAIR_LUMA_R * pixel->red +
+			  CAIR_LUMA_G * pixel->green +
+			  CAIR_LUMA_B * pixel->blue;
+	return (CML_byte)( ( (sum >> 3) * 33555 ) >> 22 );
 }
 
+#ifdef CAIR_SSE2
 //=========================================================================================================//
-//Calculate the energy map of the image using the edges and weights. When Path is set to NULL, the energy map
-//will be completely recalculated, otherwise if it contains a valid seam, it will use it to only update changed
-//portions of the energy map.
-void Energy_Map(CML_image_ptr * Source, CAIR_energy ener, int * Path)
+//Grayscale_Pixel() for the 8 pixels starting at pixel, storing them in out.
+//The luma sums need 32 bits, but once divided by 8 they fit in 16 again for the multiply by 33555 (a high half, then >> 6).
+inline void Grayscale_Pixel_8( CML_RGBA * pixel, CML_byte * out )
 {
-	int min_x, max_x;
-	int min_x_energy, max_x_energy;
-	int boundry_min_x, boundry_max_x;
-	int height = (*Source).Height()-1;
-	int width = (*Source).Width()-1;
+	__m128i zero = _mm_setzero_si128();
+	__m128i weights = _mm_setr_epi16( CAIR_LUMA_R, CAIR_LUMA_G, CAIR_LUMA_B, 0, CAIR_LUMA_R, CAIR_LUMA_G, CAIR_LUMA_B, 0 );
+	__m128i sums[2];
 
-	if(Path == NULL)
+	for( int i = 0; i < 2; i++ )
 	{
-		//calculate full region
-		min_x = 0;
-		max_x = width;
+		__m128i rgba = _mm_loadu_si128( (__m128i *)&pixel[i*4] );
+		//r*R + g*G and b*B + a*0 for each pixel, then the two halves added together
+		__m128i low = _mm_madd_epi16( _mm_unpacklo_epi8( rgba, zero ), weights );
+		__m128i high = _mm_madd_epi16( _mm_unpackhi_epi8( rgba, zero ), weights );
+		__m128i even = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( low ), _mm_castsi128_ps( high ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+		__m128i odd = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( low ), _mm_castsi128_ps( high ), _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+		sums[i] = _mm_srli_epi32( _mm_add_epi32( even, odd ), 3 );
 	}
-	else
+
+	__m128i luma = _mm_packs_epi32( sums[0], sums[1] ); //at most 31875
+	luma = _mm_srli_epi16( _mm_mulhi_epu16( luma, _mm_set1_epi16( (short)33555 ) ), 6 );
+	_mm_storel_epi64( (__m128i *)out, _mm_packus_epi16( luma, zero ) );
+}
+#endif
+
+//=========================================================================================================//
+//Our thread job for the Grayscale
+void Gray_Quadrant( Thread_Params * info )
+{
+	//get updated parameters
+	Thread_Params gray_area = *info;
+
+	CML_color * Image = &(*(gray_area.Source)).image;
+	CML_gray * Gray = &(*(gray_area.Source)).gray;
+
+	int width = (*Image).Width();
+	int simd = SIMD_Level();
+	for( int y = gray_area.top_y; y < gray_area.bot_y; y++ )
 	{
-		//restrict calculation tree based on path location
-		min_x = MAX(Path[0]-3, 0);
-		max_x = MIN(Path[0]+2, width);
+		CML_RGBA * pixels = (*Image).Row( y );
+		CML_byte * grays = (*Gray).Row( y );
+		int x = 0;
+#ifdef CAIR_SSE2
+		if( simd >= CAIR_SIMD_SSE2 )
+		{
+			for( ; x + 8 <= width; x += 8 )
+			{
+				Grayscale_Pixel_8( &pixels[x], &grays[x] );
+			}
+		}
+#endif
+		for( ; x < width; x++ )
+		{
+			grays[x] = Grayscale_Pixel( &pixels[x] );
+		}
 	}
+} //end Gray_Quadrant()
 
-	//set the first row with the correct energy
-	for(int x = min_x; x <= max_x; x++)
+//=========================================================================================================//
+//Sort-of does a RGB->YUV conversion (actually, just RGB->Y)
+//Multi-threaded with each thread getting a strip across the image.
+void Grayscale_Image( CAIR_Context * context, CML_image * Source )
+{
+	double start = Stats_Start( context );
+	int thread_height = (*Source).Height() / context->num_threads;
+
+	//setup parameters
+	for( int i = 0; i < context->num_threads; i++ )
 	{
-		(*Source)(x,0)->energy = (*Source)(x,0)->edge + (*Source)(x,0)->weight;
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].top_y = i * thread_height;
+		context->thread_info[i].bot_y = context->thread_info[i].top_y + thread_height;
 	}
 
-	for(int y = 1; y <= height; y++)
-	{
-		//each itteration we expand the width of calculations, one in each direction
-		min_x = MAX(min_x-1, 0);
-		max_x = MIN(max_x+1, width);
-		boundry_min_x = 0;
-		boundry_max_x = 0;
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_y = (*Source).Height();
 
-		//boundry conditions
-		if(max_x == width && width > 0)
+	//run the threads and wait for them to come back to us
+	Run_Threads( context, Gray_Quadrant );
+	Stats_Stop( context, STAGE_GRAYSCALE, start );
+
+} //end Grayscale_Image()
+
+//=========================================================================================================//
+//==                                                 E D G E                                             ==//
+//=========================================================================================================//
+enum edge_safe { SAFE, UNSAFE };
+
+//=========================================================================================================//
+//returns the convolution value of the pixel Gray[x][y] with one of the kernels.
+//Several kernels are avaialable, each with their strengths and weaknesses. The edge_safe
+//param will use the slower, but safer Get() method of the CML. Gray can also be a CML_Transposed view.
+template <class Matrix>
+int Convolve_Pixel( Matrix * Gray, int x, int y, edge_safe safety, CAIR_convolution convolution)
+{
+	int conv = 0;
+
+	switch( convolution )
+	{
+	case PREWITT:
+		if( safety == SAFE )
 		{
-			(*Source)(width,y)->energy = MIN((*Source)(width-1,y-1)->energy, (*Source)(width,y-1)->energy) + (*Source)(width,y)->edge + (*Source)(width,y)->weight;
-			boundry_max_x = 1; //prevent this value from being calculated in the below loops
+			conv = abs( (*Gray).Get(x+1,y+1) + (*Gray).Get(x+1,y) + (*Gray).Get(x+1,y-1) //x part of the prewitt
+					   -(*Gray).Get(x-1,y-1) - (*Gray).Get(x-1,y) - (*Gray).Get(x-1,y+1) ) +
+				   abs( (*Gray).Get(x+1,y+1) + (*Gray).Get(x,y+1) + (*Gray).Get(x-1,y+1) //y part of the prewitt
+					   -(*Gray).Get(x+1,y-1) - (*Gray).Get(x,y-1) - (*Gray).Get(x-1,y-1) );
 		}
-		if(min_x == 0)
+		else
 		{
-			(*Source)(0,y)->energy = MIN((*Source)(0,y-1)->energy, (*Source)(1,y-1)->energy) + (*Source)(0,y)->edge + (*Source)(0,y)->weight;
-			boundry_min_x = 1;
+			conv = abs( (*Gray)(x+1,y+1) + (*Gray)(x+1,y) + (*Gray)(x+1,y-1) //x part of the prewitt
+					   -(*Gray)(x-1,y-1) - (*Gray)(x-1,y) - (*Gray)(x-1,y+1) ) +
+				   abs( (*Gray)(x+1,y+1) + (*Gray)(x,y+1) + (*Gray)(x-1,y+1) //y part of the prewitt
+					   -(*Gray)(x+1,y-1) - (*Gray)(x,y-1) - (*Gray)(x-1,y-1) );
 		}
+		break;
 
-		//store the previous max/min energies, use these to see if we can trim the tree
-		min_x_energy = (*Source)(min_x,y)->energy;
-		max_x_energy = (*Source)(max_x,y)->energy;
+	 case V_SQUARE:
+		if( safety == SAFE )
+		{
+			conv = (*Gray).Get(x+1,y+1) + (*Gray).Get(x+1,y) + (*Gray).Get(x+1,y-1) //x part of the prewitt
+				  -(*Gray).Get(x-1,y-1) - (*Gray).Get(x-1,y) - (*Gray).Get(x-1,y+1);
+			conv *= conv;
+		}
+		else
+		{
+			conv = (*Gray)(x+1,y+1) + (*Gray)(x+1,y) + (*Gray)(x+1,y-1) //x part of the prewitt
+				  -(*Gray)(x-1,y-1) - (*Gray)(x-1,y) - (*Gray)(x-1,y+1);
+			conv *= conv;
+		}
+		break;
 
-		//fill in everything besides the boundries, if needed
-		if(ener == BACKWARD)
+	 case V1:
+		if( safety == SAFE )
 		{
-			for(int x = (min_x + boundry_min_x); x <= (max_x - boundry_max_x); x++)
-			{
-				(*Source)(x,y)->energy = min_of_three((*Source)(x-1,y-1)->energy,
-													  (*Source)(x,y-1)->energy,
-													  (*Source)(x+1,y-1)->energy)
-										 + (*Source)(x,y)->edge + (*Source)(x,y)->weight;
-			}
+			conv =  abs( (*Gray).Get(x+1,y+1) + (*Gray).Get(x+1,y) + (*Gray).Get(x+1,y-1) //x part of the prewitt
+						-(*Gray).Get(x-1,y-1) - (*Gray).Get(x-1,y) - (*Gray).Get(x-1,y+1) );
 		}
-		else //forward energy
+		else
 		{
-			for(int x = (min_x + boundry_min_x); x <= (max_x - boundry_max_x); x++)
-			{
-				(*Source)(x,y)->energy = min_of_three((*Source)(x-1,y-1)->energy + Forward_CostL(Source,x,y),
-													  (*Source)(x,y-1)->energy + Forward_CostU(Source,x,y),
-													  (*Source)(x+1,y-1)->energy + Forward_CostR(Source,x,y))
-										 + (*Source)(x,y)->weight;
-			}
+			conv = abs( (*Gray)(x+1,y+1) + (*Gray)(x+1,y) + (*Gray)(x+1,y-1) //x part of the prewitt
+					   -(*Gray)(x-1,y-1) - (*Gray)(x-1,y) - (*Gray)(x-1,y+1) ) ;
+		}
+		break;
+	
+	 case SOBEL:
+		if( safety == SAFE )
+		{
+			conv = abs( (*Gray).Get(x+1,y+1) + (2 * (*Gray).Get(x+1,y)) + (*Gray).Get(x+1,y-1) //x part of the sobel
+					   -(*Gray).Get(x-1,y-1) - (2 * (*Gray).Get(x-1,y)) - (*Gray).Get(x-1,y+1) ) +
+				   abs( (*Gray).Get(x+1,y+1) + (2 * (*Gray).Get(x,y+1)) + (*Gray).Get(x-1,y+1) //y part of the sobel
+					   -(*Gray).Get(x+1,y-1) - (2 * (*Gray).Get(x,y-1)) - (*Gray).Get(x-1,y-1) );
+		}
+		else
+		{
+			conv = abs( (*Gray)(x+1,y+1) + (2 * (*Gray)(x+1,y)) + (*Gray)(x+1,y-1) //x part of the sobel
+					   -(*Gray)(x-1,y-1) - (2 * (*Gray)(x-1,y)) - (*Gray)(x-1,y+1) ) +
+				   abs( (*Gray)(x+1,y+1) + (2 * (*Gray)(x,y+1)) + (*Gray)(x-1,y+1) //y part of the sobel
+					   -(*Gray)(x+1,y-1) - (2 * (*Gray)(x,y-1)) - (*Gray)(x-1,y-1) );
 		}
+		break;
 
-		//check to see if we can restrict future calculations
-		if(Path != NULL)
+	case LAPLACIAN:
+		if( safety == SAFE )
+		{
+			conv = abs( (*Gray).Get(x+1,y) + (*Gray).Get(x-1,y) + (*Gray).Get(x,y+1) + (*Gray).Get(x,y-1)
+					   -(4 * (*Gray).Get(x,y)) );
+		}
+		else
 		{
-			if((Path[y] > min_x+3) && ((*Source)(min_x,y)->energy == min_x_energy)) min_x++;
-			if((Path[y] < max_x-2) && ((*Source)(max_x,y)->energy == max_x_energy)) max_x--;
+			conv = abs( (*Gray)(x+1,y) + (*Gray)(x-1,y) + (*Gray)(x,y+1) + (*Gray)(x,y-1)
+					   -(4 * (*Gray)(x,y)) );
 		}
+		break;
 	}
+	return conv;
 }
 
-
 //=========================================================================================================//
-//Energy_Path() generates the least energy Path of the Edge and Weights and returns the total energy of that path.
-int Energy_Path( CML_image_ptr * Source, int * Path, CAIR_energy ener, bool first_time )
+//The same kernels as Convolve_Pixel(), without bounds checking, with the kernel picked at compile time.
+//up, mid, and down are the rows above, at, and below the pixel.
+template <CAIR_convolution K>
+inline int Convolve_Kernel( CML_byte * up, CML_byte * mid, CML_byte * down, int x )
 {
-	//calculate the energy map
-	if( first_time == true )
+	if( K == LAPLACIAN )
 	{
-		Energy_Map( Source, ener, NULL );
+		return abs( mid[x+1] + mid[x-1] + down[x] + up[x] - (4 * mid[x]) );
 	}
-	else
+
+	int weight = ( K == SOBEL ) ? 2 : 1;
+	int horz = down[x+1] + (weight * mid[x+1]) + up[x+1]
+			  -up[x-1] - (weight * mid[x-1]) - down[x-1];
+
+	if( K == V_SQUARE )
 	{
-		Energy_Map( Source, ener, Path );
+		return horz * horz;
 	}
-
-	//find minimum path start
-	int min_x = 0;
-	int width = (*Source).Width();
-	int height = (*Source).Height();
-	for( int x = 0; x < width; x++ )
+	if( K == V1 )
 	{
-		if( (*Source)(x,height-1)->energy < (*Source)(min_x,height-1)->energy )
-		{
-			min_x = x;
-		}
+		return abs( horz );
 	}
 
-	//generate the path back from the energy map
-	Generate_Path( Source, min_x, Path );
-	return (*Source)(min_x,height-1)->energy;
+	int vert = down[x+1] + (weight * down[x]) + down[x-1]
+			  -up[x+1] - (weight * up[x]) - up[x-1];
+	return abs( horz ) + abs( vert );
 }
 
+#ifdef CAIR_SSE2
 //=========================================================================================================//
-//==                                                 A D D                                               ==//
-//=========================================================================================================//
-
-//=========================================================================================================//
-//averages two pixels and returns the values
-CML_RGBA Average_Pixels( CML_RGBA Pixel1, CML_RGBA Pixel2 )
+//Convolve_Kernel() for the 8 pixels starting at x, storing them in out. Reads up to x+8.
+//Everything fits in 16 bits until V_SQUARE squares it.
+template <CAIR_convolution K>
+inline void Convolve_Kernel_8( CML_byte * up, CML_byte * mid, CML_byte * down, int x, int * out )
 {
-	CML_RGBA average;
-
-	average.alpha = ( Pixel1.alpha + Pixel2.alpha ) / 2;
-	average.blue = ( Pixel1.blue + Pixel2.blue ) / 2;
-	average.green = ( Pixel1.green + Pixel2.green ) / 2;
-	average.red = ( Pixel1.red + Pixel2.red ) / 2;
+	__m128i zero = _mm_setzero_si128();
+	__m128i value;
 
-	return average;
-}
-
-//=========================================================================================================//
-//This works like Remove_Quadrant, strips across the image.
-void * Add_Quadrant( void * id )
-{
-	int num = *((int *)id);
-	Thread_Params add_area;
+	__m128i mid_l = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&mid[x-1] ), zero );
+	__m128i mid_r = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&mid[x+1] ), zero );
+	__m128i up_c = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&up[x] ), zero );
+	__m128i down_c = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&down[x] ), zero );
 
-	while( true )
+	if( K == LAPLACIAN )
 	{
-		_sem_wait( &(add_sem[0]) );
-
-		//get updated_parameters
-		add_area = thread_info[num];
+		__m128i mid_c = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&mid[x] ), zero );
+		value = _mm_sub_epi16( _mm_add_epi16( _mm_add_epi16( mid_l, mid_r ), _mm_add_epi16( up_c, down_c ) ), _mm_slli_epi16( mid_c, 2 ) );
+		value = _mm_max_epi16( value, _mm_sub_epi16( zero, value ) );
+	}
+	else
+	{
+		__m128i up_l = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&up[x-1] ), zero );
+		__m128i up_r = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&up[x+1] ), zero );
+		__m128i down_l = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&down[x-1] ), zero );
+		__m128i down_r = _mm_unpacklo_epi8( _mm_loadl_epi64( (__m128i *)&down[x+1] ), zero );
 
-		if( add_area.exit == true )
+		if( K == SOBEL )
 		{
-			//thread is exiting
-			break;
+			mid_l = _mm_slli_epi16( mid_l, 1 );
+			mid_r = _mm_slli_epi16( mid_r, 1 );
+			up_c = _mm_slli_epi16( up_c, 1 );
+			down_c = _mm_slli_epi16( down_c, 1 );
 		}
 
-		//restore the image and weights from the source, we only care about the removed flags
-		int width = (*(add_area.Add_Resize)).Width();
-		for(int y = add_area.top_y; y < add_area.bot_y; y++)
+		__m128i horz = _mm_sub_epi16( _mm_add_epi16( _mm_add_epi16( down_r, mid_r ), up_r ),
+									  _mm_add_epi16( _mm_add_epi16( up_l, mid_l ), down_l ) );
+
+		if( K == V_SQUARE )
 		{
-			for(int x = 0; x < width; x++)
-			{
-				(*(add_area.Add_Resize))(x,y).image = (*(add_area.Source))(x,y)->image;
-				(*(add_area.Add_Resize))(x,y).weight = (*(add_area.Source))(x,y)->weight;
-			}
+			//16x16->32 bit multiply, put back together from the low and high halves
+			__m128i low = _mm_mullo_epi16( horz, horz );
+			__m128i high = _mm_mulhi_epi16( horz, horz );
+			_mm_storeu_si128( (__m128i *)&out[0], _mm_unpacklo_epi16( low, high ) );
+			_mm_storeu_si128( (__m128i *)&out[4], _mm_unpackhi_epi16( low, high ) );
+			return;
 		}
 
-		//signal that part is done
-		_sem_signal( &(add_sem[2]) );
-
-		//wait to begin the adding
-		_sem_wait( &(add_sem[1]) );
+		value = _mm_max_epi16( horz, _mm_sub_epi16( zero, horz ) );
 
-		//get updated_parameters
-		add_area = thread_info[num];
-
-		//now we can actually enlarge the image, inserting pixels near removed ones
-		width = (*(add_area.Add_Resize)).Width();
-		for(int y = add_area.top_y; y < add_area.bot_y; y++)
+		if( K != V1 )
 		{
-			int add_column = 0;
-			for(int x = 0; x < width; x++)
-			{
-				//copy over the pixel, setting the pointer, and incrimenting the large image to the next column
-				(*(add_area.Add_Source))(add_column,y).image = (*(add_area.Add_Resize))(x,y).image;
-				(*(add_area.Add_Source))(add_column,y).weight = (*(add_area.Add_Resize))(x,y).weight;
-				(*(add_area.Source))(add_column,y) = &(*(add_area.Add_Source))(add_column,y);
-				add_column++;
-
-				if((*(add_area.Add_Resize))(x,y).removed == true)
-				{
-					//insert a new pixel, taking the average of the current pixel and the next pixel
-					(*(add_area.Add_Source))(add_column,y).image = Average_Pixels( (*(add_area.Add_Resize))(x,y).image, (*(add_area.Add_Resize))(MIN(x+1,width-1),y).image );
-					(*(add_area.Add_Source))(add_column,y).weight = ((*(add_area.Add_Resize))(x,y).weight + (*(add_area.Add_Resize))(MIN(x+1,width-1),y).weight) / 2;
-					(*(add_area.Source))(add_column,y) = &(*(add_area.Add_Source))(add_column,y);
-					add_column++;
-				}
-			}
+			__m128i vert = _mm_sub_epi16( _mm_add_epi16( _mm_add_epi16( down_r, down_c ), down_l ),
+										  _mm_add_epi16( _mm_add_epi16( up_r, up_c ), up_l ) );
+			value = _mm_add_epi16( value, _mm_max_epi16( vert, _mm_sub_epi16( zero, vert ) ) );
 		}
+	}
 
-		//signal the add thread is done
-		_sem_signal( &(add_sem[2]) );
-
-	} //end while(true)
-	return NULL;
+	//all positive now, so widen to 32 bits with zeros
+	_mm_storeu_si128( (__m128i *)&out[0], _mm_unpacklo_epi16( value, zero ) );
+	_mm_storeu_si128( (__m128i *)&out[4], _mm_unpackhi_epi16( value, zero ) );
 }
+#endif
 
-
+#ifdef CAIR_AVX2
 //=========================================================================================================//
-//Grab the current image data from Source and put it back into Resize_img. Then create the enlarged image
-//by pulling the image and remove info from Resize_img and creating our new Source. Also, update Source_ptr
-//while we're at it.
-void Add_Path( CML_image * Resize_img, CML_image * Source, CML_image_ptr * Source_ptr, int goal_x )
+//Same as above, for the 16 pixels starting at x. Reads up to x+16.
+template <CAIR_convolution K>
+CAIR_TARGET_AVX2 inline void Convolve_Kernel_16( CML_byte * up, CML_byte * mid, CML_byte * down, int x, int * out )
 {
-	int height = (*Resize_img).Height();
-	int thread_height = height / num_threads;
+	__m256i value;
 
-	//setup parameters
-	for( int i = 0; i < num_threads; i++ )
+	__m256i mid_l = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&mid[x-1] ) );
+	__m256i mid_r = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&mid[x+1] ) );
+	__m256i up_c = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&up[x] ) );
+	__m256i down_c = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&down[x] ) );
+
+	if( K == LAPLACIAN )
 	{
-		thread_info[i].Source = Source_ptr;
-		thread_info[i].Add_Source = Source;
-		thread_info[i].Add_Resize = Resize_img;
-		thread_info[i].top_y = i * thread_height;
-		thread_info[i].bot_y = thread_info[i].top_y + thread_height;
+		__m256i mid_c = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&mid[x] ) );
+		value = _mm256_sub_epi16( _mm256_add_epi16( _mm256_add_epi16( mid_l, mid_r ), _mm256_add_epi16( up_c, down_c ) ), _mm256_slli_epi16( mid_c, 2 ) );
+		value = _mm256_abs_epi16( value );
 	}
+	else
+	{
+		__m256i up_l = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&up[x-1] ) );
+		__m256i up_r = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&up[x+1] ) );
+		__m256i down_l = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&down[x-1] ) );
+		__m256i down_r = _mm256_cvtepu8_epi16( _mm_loadu_si128( (__m128i *)&down[x+1] ) );
 
-	//have the last thread pick up the slack
-	thread_info[num_threads-1].bot_y = height;
+		if( K == SOBEL )
+		{
+			mid_l = _mm256_slli_epi16( mid_l, 1 );
+			mid_r = _mm256_slli_epi16( mid_r, 1 );
+			up_c = _mm256_slli_epi16( up_c, 1 );
+			down_c = _mm256_slli_epi16( down_c, 1 );
+		}
 
-	//startup the threads
-	for( int i = 0; i < num_threads; i++ )
-	{
-		_sem_signal( &(add_sem[0]) );
-	}
+		__m256i horz = _mm256_sub_epi16( _mm256_add_epi16( _mm256_add_epi16( down_r, mid_r ), up_r ),
+										 _mm256_add_epi16( _mm256_add_epi16( up_l, mid_l ), down_l ) );
 
-	//now wait for them to come back to us
-	for( int i = 0; i < num_threads; i++ )
-	{
-		_sem_wait( &(add_sem[2]) );
+		if( K == V_SQUARE )
+		{
+			//widen first, since the 256 bit unpacks work within each 128 bit lane
+			__m256i low = _mm256_cvtepi16_epi32( _mm256_castsi256_si128( horz ) );
+			__m256i high = _mm256_cvtepi16_epi32( _mm256_extracti128_si256( horz, 1 ) );
+			_mm256_storeu_si256( (__m256i *)&out[0], _mm256_mullo_epi32( low, low ) );
+			_mm256_storeu_si256( (__m256i *)&out[8], _mm256_mullo_epi32( high, high ) );
+			return;
+		}
+
+		value = _mm256_abs_epi16( horz );
+
+		if( K != V1 )
+		{
+			__m256i vert = _mm256_sub_epi16( _mm256_add_epi16( _mm256_add_epi16( down_r, down_c ), down_l ),
+											 _mm256_add_epi16( _mm256_add_epi16( up_r, up_c ), up_l ) );
+			value = _mm256_add_epi16( value, _mm256_abs_epi16( vert ) );
+		}
 	}
 
-	//ok, we can now resize the source to the final size
-	(*Source).D_Resize(goal_x, height);
-	(*Source_ptr).D_Resize(goal_x, height);
+	_mm256_storeu_si256( (__m256i *)&out[0], _mm256_cvtepu16_epi32( _mm256_castsi256_si128( value ) ) );
+	_mm256_storeu_si256( (__m256i *)&out[8], _mm256_cvtepu16_epi32( _mm256_extracti128_si256( value, 1 ) ) );
+}
 
-	for( int i = 0; i < num_threads; i++ )
+//=========================================================================================================//
+//Runs Convolve_Kernel_16() along a row from x, for as long as it fits before width-1. Returns where it stopped.
+template <CAIR_convolution K>
+CAIR_TARGET_AVX2 int Convolve_Row_16( CML_byte * up, CML_byte * mid, CML_byte * down, int x, int width, int * out )
+{
+	for( ; x + 16 < width; x += 16 )
 	{
-		_sem_signal( &(add_sem[1]) );
+		Convolve_Kernel_16<K>( up, mid, down, x, &out[x] );
 	}
+	return x;
+}
+#endif
+
+//=========================================================================================================//
+//Edge detect rows top_y to bot_y with kernel K. The rows above and below each one must exist.
+//The middle of each row goes through the widest SIMD kernel we have, then the leftovers and boundries are done one at a time.
+template <CAIR_convolution K>
+void Convolve_Rows( CML_gray * Gray, CML_int * Edge, int top_y, int bot_y )
+{
+	int width = (*Gray).Width();
+	int simd = SIMD_Level();
 
-	//now wait on them again
-	for( int i = 0; i < num_threads; i++ )
+	for( int y = top_y; y < bot_y; y++ )
 	{
-		_sem_wait( &(add_sem[2]) );
+		CML_byte * up = (*Gray).Row( y-1 );
+		CML_byte * mid = (*Gray).Row( y );
+		CML_byte * down = (*Gray).Row( y+1 );
+		int * out = (*Edge).Row( y );
+
+		//left most edge
+		out[0] = Convolve_Pixel( Gray, 0, y, SAFE, K );
+
+		//fill in the middle
+		int x = 1;
+#ifdef CAIR_AVX2
+		if( simd >= CAIR_SIMD_AVX2 )
+		{
+			x = Convolve_Row_16<K>( up, mid, down, x, width, out );
+		}
+#endif
+#ifdef CAIR_SSE2
+		if( simd >= CAIR_SIMD_SSE2 )
+		{
+			for( ; x + 8 < width; x += 8 )
+			{
+				Convolve_Kernel_8<K>( up, mid, down, x, &out[x] );
+			}
+		}
+#endif
+		for( ; x < width - 1; x++ )
+		{
+			out[x] = Convolve_Kernel<K>( up, mid, down, x );
+		}
+
+		//right most edge
+		out[width-1] = Convolve_Pixel( Gray, width-1, y, SAFE, K );
 	}
+}
 
-} //end Add_Path()
+//=========================================================================================================//
+//The thread job, splitting the image into strips
+void Edge_Quadrant( Thread_Params * info )
+{
+	//get updated parameters
+	Thread_Params edge_area = *info;
 
-//forward delcration
-bool CAIR_Remove( CML_image_ptr * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done );
+	CML_gray * Gray = &(*(edge_area.Source)).gray;
+	CML_int * Edge = &(*(edge_area.Source)).edge;
+
+	//pick the kernel once for the whole strip
+	switch( edge_area.conv )
+	{
+	case PREWITT:
+		Convolve_Rows<PREWITT>( Gray, Edge, edge_area.top_y, edge_area.bot_y );
+		break;
+	case V1:
+		Convolve_Rows<V1>( Gray, Edge, edge_area.top_y, edge_area.bot_y );
+		break;
+	case V_SQUARE:
+		Convolve_Rows<V_SQUARE>( Gray, Edge, edge_area.top_y, edge_area.bot_y );
+		break;
+	case SOBEL:
+		Convolve_Rows<SOBEL>( Gray, Edge, edge_area.top_y, edge_area.bot_y );
+		break;
+	case LAPLACIAN:
+		Convolve_Rows<LAPLACIAN>( Gray, Edge, edge_area.top_y, edge_area.bot_y );
+		break;
+	}
+}
+
+//=========================================================================================================//
+//Performs full edge detection on Source with one of the kernels.
+void Edge_Detect( CAIR_Context * context, CML_image * Source, CAIR_convolution conv )
+{
+	//There is no easy solution to the boundries. Calling the same boundry pixel to convolve itself against seems actually better
+	//than padding the image with zeros or 255's.
+	//Calling itself induces a "ringing" into the near edge of the image. Padding can lead to a darker or lighter edge.
+	//The only "good" solution is to have the entire one-pixel wide edge not included in the edge detected image.
+	//This would reduce the size of the image by 2 pixels in both directions, something that is unacceptable here.
+
+	double start = Stats_Start( context );
+	int thread_height = (*Source).Height() / context->num_threads;
+	int height = (*Source).Height();
+	int width = (*Source).Width();
+
+	//setup parameters
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].top_y = (i * thread_height) + 1; //handle very top row down below
+		context->thread_info[i].bot_y = MIN( context->thread_info[i].top_y + thread_height, height - 1 ); //short images run out of rows
+		context->thread_info[i].conv = conv;
+	}
+
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_y = height - 1; //handle very bottom row down below
+
+	//start the threads
+	Start_Threads( context, Edge_Quadrant );
+
+	//while those are running we can go back and do the boundry pixels with the extra safety checks
+	for( int x = 0; x < width; x++ )
+	{
+		(*Source).edge(x,0) = Convolve_Pixel( &(*Source).gray, x, 0, SAFE, conv );
+		(*Source).edge(x,height-1) = Convolve_Pixel( &(*Source).gray, x, height-1, SAFE, conv );
+	}
+
+	//now wait on them
+	Wait_Threads( context );
+	Stats_Stop( context, STAGE_EDGE, start );
+
+} //end Edge_Detect()
+
+//=========================================================================================================//
+//==                                           E N E R G Y                                               ==//
+//=========================================================================================================//
+
+//=========================================================================================================//
+//Simple fuction returning the minimum of three values.
+//The obvious MIN(MIN(x,y),z) is actually undesirable, since that would guarantee three branch checks.
+//This one here sucks up a variable to guarantee only two branches.
+inline int min_of_three( int x, int y, int z )
+{
+	int min = y;
+
+	if( x < min )
+	{
+		min = x;
+	}
+	if( z < min )
+	{
+		return z;
+	}
+
+	return min;
+}
+
+//=========================================================================================================//
+//Get the value from the integer matrix, return a large value if out-of-bounds in the x-direction.
+template <class Matrix>
+inline int Get_Max( Matrix * Energy, int x, int y )
+{
+	if( ( x < 0 ) || ( x >= (*Energy).Width() ) )
+	{
+		return std::numeric_limits<int>::max();
+	}
+	else
+	{
+		return (*Energy)(x,y);
+	}
+}
+
+//=========================================================================================================//
+//This calculates a minimum energy path from the given start point (min_x) and the energy map.
+//Energy can also be a CML_Transposed view.
+template <class Matrix>
+void Generate_Path( Matrix * Energy, int min_x, int * Path )
+{
+	int min;
+	int x = min_x;
+
+	int height = (*Energy).Height();
+	for( int y = height - 1; y >= 0; y-- ) //builds from bottom up
+	{
+		min = x; //assume the minimum is straight up
+
+		if( Get_Max( Energy, x-1, y ) < Get_Max( Energy, min, y ) ) //check to see if min is up-left
+		{
+			min = x - 1;
+		}
+		if( Get_Max( Energy, x+1, y ) < Get_Max( Energy, min, y) ) //up-right
+		{
+			min = x + 1;
+		}
+		
+		Path[y] = min;
+		x = min;
+	}
+}
+
+//=========================================================================================================//
+//Finds the least energy seam in a finished energy map, storing it in Path and returning its total energy.
+//Energy can also be a CML_Transposed view.
+template <class Matrix>
+int Least_Path( Matrix * Energy, int * Path )
+{
+	//find minimum path start
+	int min_x = 0;
+	int width = (*Energy).Width();
+	int height = (*Energy).Height();
+	for( int x = 0; x < width; x++ )
+	{
+		if( (*Energy)(x,height-1) < (*Energy)(min_x,height-1) )
+		{
+			min_x = x;
+		}
+	}
+
+	//generate the path back from the energy map
+	Generate_Path( Energy, min_x, Path );
+	return (*Energy)(min_x,height-1);
+}
+
+#ifdef CAIR_SSE2
+//=========================================================================================================//
+//SSE2 doesn't have a 32 bit min() or abs(), so build them out of compares and shifts.
+inline __m128i Min_Epi32( __m128i a, __m128i b )
+{
+#ifdef __SSE4_1__
+	return _mm_min_epi32( a, b );
+#else
+	__m128i less = _mm_cmplt_epi32( a, b );
+	return _mm_or_si128( _mm_and_si128( less, a ), _mm_andnot_si128( less, b ) );
+#endif
+}
+
+inline __m128i Abs_Epi32( __m128i a )
+{
+	__m128i sign = _mm_srai_epi32( a, 31 );
+	return _mm_sub_epi32( _mm_xor_si128( a, sign ), sign );
+}
+#endif
+
+#ifdef CAIR_AVX512
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" //some GCC versions trip over their own _mm512_min_epi32()
+#endif
+//=========================================================================================================//
+//The AVX-512 part of Energy_Row(), 16 at a time from x for as long as they fit before end. Returns where it stopped.
+template <CAIR_energy E>
+CAIR_TARGET_AVX512 int Energy_Row_16( int * energy, int * energy_up, int * edge, int * edge_up, int * weight, int x, int end )
+{
+	for( ; x + 15 <= end; x += 16 )
+	{
+		__m512i left = _mm512_loadu_si512( &energy_up[x-1] );
+		__m512i up = _mm512_loadu_si512( &energy_up[x] );
+		__m512i right = _mm512_loadu_si512( &energy_up[x+1] );
+		__m512i value;
+
+		if( E == BACKWARD )
+		{
+			value = _mm512_min_epi32( _mm512_min_epi32( left, up ), right );
+			value = _mm512_add_epi32( value, _mm512_loadu_si512( &edge[x] ) );
+		}
+		else
+		{
+			__m512i edge_l = _mm512_loadu_si512( &edge[x-1] );
+			__m512i edge_r = _mm512_loadu_si512( &edge[x+1] );
+			__m512i edge_u = _mm512_loadu_si512( &edge_up[x] );
+			__m512i cost_u = _mm512_abs_epi32( _mm512_sub_epi32( edge_r, edge_l ) );
+			__m512i cost_l = _mm512_add_epi32( cost_u, _mm512_abs_epi32( _mm512_sub_epi32( edge_u, edge_l ) ) );
+			__m512i cost_r = _mm512_add_epi32( cost_u, _mm512_abs_epi32( _mm512_sub_epi32( edge_u, edge_r ) ) );
+			value = _mm512_min_epi32( _mm512_min_epi32( _mm512_add_epi32( left, cost_l ), _mm512_add_epi32( up, cost_u ) ),
+									  _mm512_add_epi32( right, cost_r ) );
+		}
+
+		value = _mm512_add_epi32( value, _mm512_loadu_si512( &weight[x] ) );
+		_mm512_storeu_si512( &energy[x], value );
+	}
+	return x;
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#ifdef CAIR_AVX2
+//=========================================================================================================//
+//The AVX2 part of Energy_Row(), 8 at a time. Returns where it stopped.
+template <CAIR_energy E>
+CAIR_TARGET_AVX2 int Energy_Row_8( int * energy, int * energy_up, int * edge, int * edge_up, int * weight, int x, int end )
+{
+	for( ; x + 7 <= end; x += 8 )
+	{
+		__m256i left = _mm256_loadu_si256( (__m256i *)&energy_up[x-1] );
+		__m256i up = _mm256_loadu_si256( (__m256i *)&energy_up[x] );
+		__m256i right = _mm256_loadu_si256( (__m256i *)&energy_up[x+1] );
+		__m256i value;
+
+		if( E == BACKWARD )
+		{
+			value = _mm256_min_epi32( _mm256_min_epi32( left, up ), right );
+			value = _mm256_add_epi32( value, _mm256_loadu_si256( (__m256i *)&edge[x] ) );
+		}
+		else
+		{
+			__m256i edge_l = _mm256_loadu_si256( (__m256i *)&edge[x-1] );
+			__m256i edge_r = _mm256_loadu_si256( (__m256i *)&edge[x+1] );
+			__m256i edge_u = _mm256_loadu_si256( (__m256i *)&edge_up[x] );
+			__m256i cost_u = _mm256_abs_epi32( _mm256_sub_epi32( edge_r, edge_l ) );
+			__m256i cost_l = _mm256_add_epi32( cost_u, _mm256_abs_epi32( _mm256_sub_epi32( edge_u, edge_l ) ) );
+			__m256i cost_r = _mm256_add_epi32( cost_u, _mm256_abs_epi32( _mm256_sub_epi32( edge_u, edge_r ) ) );
+			value = _mm256_min_epi32( _mm256_min_epi32( _mm256_add_epi32( left, cost_l ), _mm256_add_epi32( up, cost_u ) ),
+									  _mm256_add_epi32( right, cost_r ) );
+		}
+
+		value = _mm256_add_epi32( value, _mm256_loadu_si256( (__m256i *)&weight[x] ) );
+		_mm256_storeu_si256( (__m256i *)&energy[x], value );
+	}
+	return x;
+}
+#endif
+
+//=========================================================================================================//
+//Fills in energy[start] to energy[end] of one row from the row above it. Both neighbors of every x must exist.
+//Each x only depends on the row above, so the row is done in SIMD chunks with the scalar loop finishing the rest.
+//Forward energy adds the cost of the new neighbors each path creates, see the paper "Improved Seam Carving for Video Retargeting"
+//by Michael Rubinstein, Ariel Shamir, and Shai Avidan. The up cost is |right - left|, and left/right also add |above - left/right|.
+template <CAIR_energy E>
+inline void Energy_Row( int * energy, int * energy_up, int * edge, int * edge_up, int * weight, int start, int end )
+{
+	int x = start;
+	int simd = SIMD_Level();
+
+#ifdef CAIR_AVX512
+	if( simd >= CAIR_SIMD_AVX512 )
+	{
+		x = Energy_Row_16<E>( energy, energy_up, edge, edge_up, weight, x, end );
+	}
+#endif
+#ifdef CAIR_AVX2
+	if( simd >= CAIR_SIMD_AVX2 )
+	{
+		x = Energy_Row_8<E>( energy, energy_up, edge, edge_up, weight, x, end );
+	}
+#endif
+#ifdef CAIR_SSE2
+	if( simd >= CAIR_SIMD_SSE2 )
+	{
+		for( ; x + 3 <= end; x += 4 )
+		{
+			__m128i left = _mm_loadu_si128( (__m128i *)&energy_up[x-1] );
+			__m128i up = _mm_loadu_si128( (__m128i *)&energy_up[x] );
+			__m128i right = _mm_loadu_si128( (__m128i *)&energy_up[x+1] );
+			__m128i value;
+
+			if( E == BACKWARD )
+			{
+				value = Min_Epi32( Min_Epi32( left, up ), right );
+				value = _mm_add_epi32( value, _mm_loadu_si128( (__m128i *)&edge[x] ) );
+			}
+			else
+			{
+				__m128i edge_l = _mm_loadu_si128( (__m128i *)&edge[x-1] );
+				__m128i edge_r = _mm_loadu_si128( (__m128i *)&edge[x+1] );
+				__m128i edge_u = _mm_loadu_si128( (__m128i *)&edge_up[x] );
+				__m128i cost_u = Abs_Epi32( _mm_sub_epi32( edge_r, edge_l ) );
+				__m128i cost_l = _mm_add_epi32( cost_u, Abs_Epi32( _mm_sub_epi32( edge_u, edge_l ) ) );
+				__m128i cost_r = _mm_add_epi32( cost_u, Abs_Epi32( _mm_sub_epi32( edge_u, edge_r ) ) );
+				value = Min_Epi32( Min_Epi32( _mm_add_epi32( left, cost_l ), _mm_add_epi32( up, cost_u ) ),
+								   _mm_add_epi32( right, cost_r ) );
+			}
+
+			value = _mm_add_epi32( value, _mm_loadu_si128( (__m128i *)&weight[x] ) );
+			_mm_storeu_si128( (__m128i *)&energy[x], value );
+		}
+	}
+#endif
+
+	for( ; x <= end; x++ )
+	{
+		if( E == BACKWARD )
+		{
+			energy[x] = min_of_three( energy_up[x-1], energy_up[x], energy_up[x+1] ) + edge[x] + weight[x];
+		}
+		else
+		{
+			int cost_u = abs( edge[x+1] - edge[x-1] );
+			energy[x] = min_of_three( energy_up[x-1] + (cost_u + abs( edge_up[x] - edge[x-1] )),
+									  energy_up[x] + cost_u,
+									  energy_up[x+1] + (cost_u + abs( edge_up[x] - edge[x+1] )) )
+						+ weight[x];
+		}
+	}
+}
+
+//=========================================================================================================//
+//Calculate the energy map of the image using the edges and weights. When Path is set to NULL, the energy map
+//will be completely recalculated, otherwise if it contains a valid seam, it will use it to only update changed
+//portions of the energy map.
+//The update stops widening once the energy at its sides stops changing. With forward energy a pixel also looks at the
+//edges next to it, and the removal can change those one column further out than the update keeps, so the result can differ
+//from a full map. CAIR() has always worked that way and keeps it; exact keeps that extra column, see Trim_Reach().
+void Energy_Map_Parallel( CAIR_Context * context, CML_image * Source, CAIR_energy ener );
+
+//=========================================================================================================//
+//How many more columns on each side of the seam an update around it has to keep, so it comes out the same as a full map.
+inline int Trim_Reach( CAIR_energy ener, bool exact )
+{
+	return ( (exact == true) && (ener == FORWARD) ) ? 1 : 0;
+}
+
+void Energy_Map( CAIR_Context * context, CML_image * Source, CAIR_energy ener, int * Path, bool exact )
+{
+	double start = Stats_Start( context );
+	long long full_cells = (long long)(*Source).Width() * (*Source).Height();
+
+	//big full recalculations get split across the threads
+	if( (Path == NULL) && (context->num_threads > 1) &&
+		(full_cells >= CAIR_PARALLEL_ENERGY) &&
+		((*Source).Width() / context->num_threads >= 4 * CAIR_ENERGY_BLOCK) )
+	{
+		Energy_Map_Parallel( context, Source, ener );
+		Stats_Cells( context, full_cells, full_cells );
+		Stats_Stop( context, STAGE_ENERGY, start );
+		return;
+	}
+
+	CML_int * Energy = &(*Source).energy;
+	CML_int * Edge = &(*Source).edge;
+	CML_int * Weight = &(*Source).weight;
+
+	int min_x, max_x;
+	int min_x_energy, max_x_energy;
+	int boundry_min_x, boundry_max_x;
+	int height = (*Source).Height()-1;
+	int width = (*Source).Width()-1;
+	int reach = Trim_Reach( ener, exact );
+
+	if(Path == NULL)
+	{
+		//calculate full region
+		min_x = 0;
+		max_x = width;
+	}
+	else
+	{
+		//restrict calculation tree based on path location
+		min_x = MAX(Path[0]-3-reach, 0);
+		max_x = MIN(Path[0]+2+reach, width);
+	}
+
+	//set the first row with the correct energy
+	for(int x = min_x; x <= max_x; x++)
+	{
+		(*Energy)(x,0) = (*Edge)(x,0) + (*Weight)(x,0);
+	}
+	long long cells = max_x - min_x + 1;
+
+	for(int y = 1; y <= height; y++)
+	{
+		//each itteration we expand the width of calculations, one in each direction
+		min_x = MAX(min_x-1, 0);
+		max_x = MIN(max_x+1, width);
+		boundry_min_x = 0;
+		boundry_max_x = 0;
+		cells += max_x - min_x + 1;
+
+		//boundry conditions
+		if(max_x == width && width > 0)
+		{
+			(*Energy)(width,y) = MIN((*Energy)(width-1,y-1), (*Energy)(width,y-1)) + (*Edge)(width,y) + (*Weight)(width,y);
+			boundry_max_x = 1; //prevent this value from being calculated in the below loops
+		}
+		if(min_x == 0)
+		{
+			(*Energy)(0,y) = MIN((*Energy)(0,y-1), (*Energy)(MIN(1,width),y-1)) + (*Edge)(0,y) + (*Weight)(0,y); //one column images have no right neighbor
+			boundry_min_x = 1;
+		}
+
+		//store the previous max/min energies, use these to see if we can trim the tree
+		min_x_energy = (*Energy)(min_x,y);
+		max_x_energy = (*Energy)(max_x,y);
+
+		//fill in everything besides the boundries, if needed
+		if(ener == BACKWARD)
+		{
+			Energy_Row<BACKWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y),
+								  min_x + boundry_min_x, max_x - boundry_max_x );
+		}
+		else //forward energy
+		{
+			Energy_Row<FORWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y),
+								 min_x + boundry_min_x, max_x - boundry_max_x );
+		}
+
+		//check to see if we can restrict future calculations
+		if(Path != NULL)
+		{
+			if((Path[y] > min_x+3+reach) && ((*Energy)(min_x,y) == min_x_energy)) min_x++;
+			if((Path[y] < max_x-2-reach) && ((*Energy)(max_x,y) == max_x_energy)) max_x--;
+		}
+	}
+
+	Stats_Cells( context, cells, full_cells );
+	Stats_Stop( context, STAGE_ENERGY, start );
+}
+
+//=========================================================================================================//
+//Fills in row y of the energy map from x = start to x = end, including the image boundries if the span touches them.
+void Energy_Span( CML_image * Source, CAIR_energy ener, int y, int start, int end )
+{
+	CML_int * Energy = &(*Source).energy;
+	CML_int * Edge = &(*Source).edge;
+	CML_int * Weight = &(*Source).weight;
+	int width = (*Source).Width()-1;
+
+	if( start == 0 )
+	{
+		(*Energy)(0,y) = MIN((*Energy)(0,y-1), (*Energy)(MIN(1,width),y-1)) + (*Edge)(0,y) + (*Weight)(0,y);
+		start = 1;
+	}
+	if( (end == width) && (width > 0) )
+	{
+		(*Energy)(width,y) = MIN((*Energy)(width-1,y-1), (*Energy)(width,y-1)) + (*Edge)(width,y) + (*Weight)(width,y);
+		end = width - 1;
+	}
+
+	if( ener == BACKWARD )
+	{
+		Energy_Row<BACKWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y), start, end );
+	}
+	else
+	{
+		Energy_Row<FORWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y), start, end );
+	}
+}
+
+//=========================================================================================================//
+//First half of a parallel energy block. Each thread has a band of columns (top_x to bot_x) and does the rows top_y to bot_y.
+//Every row only needs the three pixels above it, so the band shrinks by one on each side per row, leaving a trapezoid that
+//doesn't need anything from the other threads. The image boundries don't shrink.
+void Energy_Band_Quadrant( Thread_Params * info )
+{
+	Thread_Params energy_area = *info;
+	int width = (*(energy_area.Source)).Width()-1;
+
+	for( int y = energy_area.top_y; y < energy_area.bot_y; y++ )
+	{
+		int row = y - energy_area.top_y;
+		int start = ( energy_area.top_x == 0 ) ? 0 : energy_area.top_x + row;
+		int end = ( energy_area.bot_x == width ) ? width : energy_area.bot_x - row;
+
+		Energy_Span( energy_area.Source, energy_area.ener, y, start, end );
+	}
+}
+
+//=========================================================================================================//
+//Second half of a parallel energy block. Fills in the upside-down triangle left between our band and the next one, going down
+//the rows so each one has what it needs from the trapezoids and the row before it.
+void Energy_Seam_Quadrant( Thread_Params * info )
+{
+	Thread_Params energy_area = *info;
+	int width = (*(energy_area.Source)).Width()-1;
+
+	if( energy_area.bot_x == width ) //no neighbor on the right
+	{
+		return;
+	}
+
+	int boundry = energy_area.bot_x + 1; //first column of the next band
+	for( int y = energy_area.top_y + 1; y < energy_area.bot_y; y++ )
+	{
+		int row = y - energy_area.top_y;
+		Energy_Span( energy_area.Source, energy_area.ener, y, boundry - row, boundry + row - 1 );
+	}
+}
+
+//=========================================================================================================//
+//Full energy map calculation split across the threads. The image is done in blocks of CAIR_ENERGY_BLOCK rows, each of which is a
+//trapezoid pass and then a pass to fill the gaps between them. So it costs two thread syncs per block instead of one per row.
+//Gives the exact same map as the single threaded version.
+void Energy_Map_Parallel( CAIR_Context * context, CML_image * Source, CAIR_energy ener )
+{
+	CML_int * Energy = &(*Source).energy;
+	CML_int * Edge = &(*Source).edge;
+	CML_int * Weight = &(*Source).weight;
+	int height = (*Source).Height();
+	int width = (*Source).Width();
+	int band_width = width / context->num_threads;
+
+	//set the first row with the correct energy
+	for( int x = 0; x < width; x++ )
+	{
+		(*Energy)(x,0) = (*Edge)(x,0) + (*Weight)(x,0);
+	}
+
+	//setup the bands
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].ener = ener;
+		context->thread_info[i].top_x = i * band_width;
+		context->thread_info[i].bot_x = context->thread_info[i].top_x + band_width - 1;
+	}
+
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_x = width - 1;
+
+	for( int top_y = 1; top_y < height; top_y += CAIR_ENERGY_BLOCK )
+	{
+		for( int i = 0; i < context->num_threads; i++ )
+		{
+			context->thread_info[i].top_y = top_y;
+			context->thread_info[i].bot_y = MIN( top_y + CAIR_ENERGY_BLOCK, height );
+		}
+
+		Run_Threads( context, Energy_Band_Quadrant );
+		Run_Threads( context, Energy_Seam_Quadrant );
+	}
+}
+
+//=========================================================================================================//
+//Energy_Map() for just columns left to right, as if they were the whole image. The rest of the map is left alone.
+void Energy_Band_Map( CAIR_Context * context, CML_image * Source, CAIR_energy ener, int left, int right )
+{
+	double start = Stats_Start( context );
+
+	CML_int * Energy = &(*Source).energy;
+	CML_int * Edge = &(*Source).edge;
+	CML_int * Weight = &(*Source).weight;
+	int height = (*Source).Height()-1;
+
+	//set the first row with the correct energy
+	for(int x = left; x <= right; x++)
+	{
+		(*Energy)(x,0) = (*Edge)(x,0) + (*Weight)(x,0);
+	}
+
+	for(int y = 1; y <= height; y++)
+	{
+		if(left == right)
+		{
+			(*Energy)(left,y) = (*Energy)(left,y-1) + (*Edge)(left,y) + (*Weight)(left,y);
+			continue;
+		}
+
+		//the band's edges act like the image's
+		(*Energy)(left,y) = MIN((*Energy)(left,y-1), (*Energy)(left+1,y-1)) + (*Edge)(left,y) + (*Weight)(left,y);
+		(*Energy)(right,y) = MIN((*Energy)(right-1,y-1), (*Energy)(right,y-1)) + (*Edge)(right,y) + (*Weight)(right,y);
+
+		if(ener == BACKWARD)
+		{
+			Energy_Row<BACKWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y), left + 1, right - 1 );
+		}
+		else //forward energy
+		{
+			Energy_Row<FORWARD>( (*Energy).Row(y), (*Energy).Row(y-1), (*Edge).Row(y), (*Edge).Row(y-1), (*Weight).Row(y), left + 1, right - 1 );
+		}
+	}
+
+	Stats_Cells( context, (long long)(right - left + 1) * (height + 1), (long long)(*Source).Width() * (height + 1) );
+	Stats_Stop( context, STAGE_ENERGY, start );
+}
+
+//=========================================================================================================//
+//Energy_Path() generates the least energy Path of the Edge and Weights and returns the total energy of that path.
+int Energy_Path( CAIR_Context * context, CML_image * Source, int * Path, CAIR_energy ener, bool first_time )
+{
+	//calculate the energy map
+	if( first_time == true )
+	{
+		Energy_Map( context, Source, ener, NULL, false );
+	}
+	else
+	{
+		Energy_Map( context, Source, ener, Path, false );
+	}
+
+	double start = Stats_Start( context );
+	int energy = Least_Path( &(*Source).energy, Path );
+	Stats_Stop( context, STAGE_PATH, start );
+	return energy;
+}
+
+//=========================================================================================================//
+//Plain version of Energy_Map(), for when its row pointers can't be used. Mainly for CML_Transposed views, which give the
+//energy for horizontal seams straight from the untransposed image. Same math, including the update around the last Path
+//and what exact does to it. When Path is NULL, rows top_y and down are recalculated in full. Returns how many entries were calculated.
+template <class Energy_Matrix, class Matrix>
+long long Energy_Map_Scalar( Energy_Matrix * Energy, Matrix * Edge, Matrix * Weight, CAIR_energy ener, int * Path, int top_y, bool exact )
+{
+	int min_x, max_x;
+	int min_x_energy, max_x_energy;
+	int boundry_min_x, boundry_max_x;
+	int height = (*Edge).Height()-1;
+	int width = (*Edge).Width()-1;
+	int reach = Trim_Reach( ener, exact );
+
+	if(Path == NULL)
+	{
+		//calculate full region
+		min_x = 0;
+		max_x = width;
+	}
+	else
+	{
+		//restrict calculation tree based on path location
+		min_x = MAX(Path[0]-3-reach, 0);
+		max_x = MIN(Path[0]+2+reach, width);
+		top_y = 0;
+	}
+
+	//set the first row with the correct energy
+	long long cells = 0;
+	if( top_y <= 0 )
+	{
+		for(int x = min_x; x <= max_x; x++)
+		{
+			(*Energy)(x,0) = (*Edge)(x,0) + (*Weight)(x,0);
+		}
+		cells = max_x - min_x + 1;
+		top_y = 1;
+	}
+
+	for(int y = top_y; y <= height; y++)
+	{
+		//each itteration we expand the width of calculations, one in each direction
+		min_x = MAX(min_x-1, 0);
+		max_x = MIN(max_x+1, width);
+		boundry_min_x = 0;
+		boundry_max_x = 0;
+		cells += max_x - min_x + 1;
+
+		//boundry conditions
+		if(max_x == width && width > 0)
+		{
+			(*Energy)(width,y) = MIN((*Energy)(width-1,y-1), (*Energy)(width,y-1)) + (*Edge)(width,y) + (*Weight)(width,y);
+			boundry_max_x = 1; //prevent this value from being calculated in the below loops
+		}
+		if(min_x == 0)
+		{
+			(*Energy)(0,y) = MIN((*Energy)(0,y-1), (*Energy)(MIN(1,width),y-1)) + (*Edge)(0,y) + (*Weight)(0,y);
+			boundry_min_x = 1;
+		}
+
+		//store the previous max/min energies, use these to see if we can trim the tree
+		min_x_energy = (*Energy)(min_x,y);
+		max_x_energy = (*Energy)(max_x,y);
+
+		//fill in everything besides the boundries, if needed
+		for(int x = (min_x + boundry_min_x); x <= (max_x - boundry_max_x); x++)
+		{
+			if(ener == BACKWARD)
+			{
+				(*Energy)(x,y) = min_of_three( (*Energy)(x-1,y-1), (*Energy)(x,y-1), (*Energy)(x+1,y-1) )
+								 + (*Edge)(x,y) + (*Weight)(x,y);
+			}
+			else //forward energy
+			{
+				int cost_u = abs( (*Edge)(x+1,y) - (*Edge)(x-1,y) );
+				(*Energy)(x,y) = min_of_three( (*Energy)(x-1,y-1) + (cost_u + abs( (*Edge)(x,y-1) - (*Edge)(x-1,y) )),
+											   (*Energy)(x,y-1) + cost_u,
+											   (*Energy)(x+1,y-1) + (cost_u + abs( (*Edge)(x,y-1) - (*Edge)(x+1,y) )) )
+								 + (*Weight)(x,y);
+			}
+		}
+
+		//check to see if we can restrict future calculations
+		if(Path != NULL)
+		{
+			if((Path[y] > min_x+3+reach) && ((*Energy)(min_x,y) == min_x_energy)) min_x++;
+			if((Path[y] < max_x-2-reach) && ((*Energy)(max_x,y) == max_x_energy)) max_x--;
+		}
+	}
+	return cells;
+}
+
+//=========================================================================================================//
+//Energy_Path() for horizontal seams, without transposing Source. Needs Source to be tracking its h_energy.
+//Path gets one entry per column, holding the row to remove. As with Energy_Map_Scalar(), when Path is NULL the rows of
+//the transposed map from top_y down are recalculated, otherwise the map is updated around the seam in Path, exactly.
+int Energy_H_Path( CAIR_Context * context, CML_image * Source, int * Path, CAIR_energy ener, bool use_path, int top_y )
+{
+	CML_Transposed<int> Edge( &(*Source).edge );
+	CML_Transposed<int> Weight( &(*Source).weight );
+
+	double start = Stats_Start( context );
+	long long cells = Energy_Map_Scalar( &(*Source).h_energy, &Edge, &Weight, ener, use_path ? Path : NULL, top_y, true );
+	Stats_Cells( context, cells, (long long)Edge.Width() * Edge.Height() );
+	Stats_Stop( context, STAGE_ENERGY, start );
+
+	start = Stats_Start( context );
+	int energy = Least_Path( &(*Source).h_energy, Path );
+	Stats_Stop( context, STAGE_PATH, start );
+	return energy;
+}
+
+//=========================================================================================================//
+//Recalculate the vertical energy map from row top_y down, keeping the rows above it.
+void Energy_Map_Rows( CAIR_Context * context, CML_image * Source, CAIR_energy ener, int top_y )
+{
+	if( top_y <= 0 )
+	{
+		Energy_Map( context, Source, ener, NULL, false );
+		return;
+	}
+
+	double start = Stats_Start( context );
+	for( int y = top_y; y < (*Source).Height(); y++ )
+	{
+		Energy_Span( Source, ener, y, 0, (*Source).Width()-1 );
+	}
+	Stats_Cells( context, (long long)MAX( (*Source).Height() - top_y, 0 ) * (*Source).Width(), (long long)(*Source).Width() * (*Source).Height() );
+	Stats_Stop( context, STAGE_ENERGY, start );
+}
+
+//=========================================================================================================//
+//Get the energy of x,y for a seam being traced, return a large value if out-of-bounds or already used by another seam.
+inline int Get_Free( CML_int * Energy, CML_Matrix<bool> * Taken, int x, int y )
+{
+	if( ( x < 0 ) || ( x >= (*Energy).Width() ) || ( (*Taken)(x,y) == true ) )
+	{
+		return std::numeric_limits<int>::max();
+	}
+	else
+	{
+		return (*Energy)(x,y);
+	}
+}
+
+//=========================================================================================================//
+//Compares bottom row positions by energy, leftmost first on a tie, like Energy_Path() does.
+struct Energy_Less
+{
+	int * energy;
+	bool operator()( int a, int b ) const
+	{
+		return ( energy[a] < energy[b] ) || ( ( energy[a] == energy[b] ) && ( a < b ) );
+	}
+};
+
+//=========================================================================================================//
+//Finds up to seams non-overlapping paths from one full energy map. Paths are traced up from the lowest bottom row energies,
+//the same way Generate_Path() does, except pixels taken by an earlier path are off limits: Get_Free() gives them INT_MAX, and a
+//path whose three choices are all INT_MAX is boxed in and dropped. While tracing, Paths has room for seams paths per row, and
+//path s of row y goes in Paths[y*seams + s]. Once done the rows are packed down, so the result is Paths[y*found + s].
+//Returns how many were found, which is at least one.
+int Energy_Paths( CAIR_Context * context, CML_image * Source, int * Paths, int seams, CAIR_energy ener )
+{
+	Energy_Map( context, Source, ener, NULL, false );
+	double start = Stats_Start( context );
+
+	int width = (*Source).Width();
+	int height = (*Source).Height();
+	CML_int * Energy = &(*Source).energy;
+	CML_Matrix<bool> * Taken = &context->taken;
+
+	//the taken map is always all false between calls, so shrinking it keeps it that way
+	if( ((*Taken).Height() != height) || ((*Taken).Stride() < width) )
+	{
+		(*Taken).D_Resize( width, height );
+		(*Taken).Fill( false );
+	}
+	(*Taken).Resize_Width( width );
+
+	//order the seam starts from least to most energy
+	int * Order = Scratch_Path( context, 1, width );
+	for( int x = 0; x < width; x++ )
+	{
+		Order[x] = x;
+	}
+	Energy_Less less;
+	less.energy = (*Energy).Row( height-1 );
+	int candidates = MIN( width, 16 * seams ); //seams tend to crowd into the same valleys, so keep plenty of spares
+	std::partial_sort( Order, Order + candidates, Order + width, less );
+
+	int found = 0;
+	for( int c = 0; (c < candidates) && (found < seams); c++ )
+	{
+		int x = Order[c];
+		int y;
+		for( y = height - 1; y >= 0; y-- ) //builds from bottom up
+		{
+			int min = x; //assume the minimum is straight up
+
+			if( Get_Free( Energy, Taken, x-1, y ) < Get_Free( Energy, Taken, min, y ) ) //check to see if min is up-left
+			{
+				min = x - 1;
+			}
+			if( Get_Free( Energy, Taken, x+1, y ) < Get_Free( Energy, Taken, min, y ) ) //up-right
+			{
+				min = x + 1;
+			}
+			if( Get_Free( Energy, Taken, min, y ) == std::numeric_limits<int>::max() )
+			{
+				break; //boxed in
+			}
+
+			(*Taken)(min,y) = true;
+			Paths[y*seams + found] = min;
+			x = min;
+		}
+
+		if( y < 0 )
+		{
+			found++;
+		}
+		else
+		{
+			//give back what we took
+			for( y = y + 1; y < height; y++ )
+			{
+				(*Taken)( Paths[y*seams + found], y ) = false;
+			}
+		}
+	}
+
+	//pack the rows down if some paths were dropped, and clean up the taken map for next time
+	for( int y = 0; y < height; y++ )
+	{
+		for( int s = 0; s < found; s++ )
+		{
+			Paths[y*found + s] = Paths[y*seams + s];
+			(*Taken)( Paths[y*found + s], y ) = false;
+		}
+	}
+
+	Stats_Stop( context, STAGE_PATH, start );
+	return found;
+}
+
+//=========================================================================================================//
+//==                                                 A D D                                               ==//
+//=========================================================================================================//
+
+//=========================================================================================================//
+//averages two pixels and returns the values
+CML_RGBA Average_Pixels( CML_RGBA Pixel1, CML_RGBA Pixel2 )
+{
+	CML_RGBA average;
+
+	average.alpha = ( Pixel1.alpha + Pixel2.alpha ) / 2;
+	average.blue = ( Pixel1.blue + Pixel2.blue ) / 2;
+	average.green = ( Pixel1.green + Pixel2.green ) / 2;
+	average.red = ( Pixel1.red + Pixel2.red ) / 2;
+
+	return average;
+}
+
+//=========================================================================================================//
+//Enlarge the image, inserting pixels next to the ones that were removed. This works like Remove_Quadrant, strips across the image.
+//Source's rows start with the original pixels and weights, and have room for the enlarged ones. Each row is filled in from its
+//end back to its start, so every original is read before anything is written over it.
+void Add_Quadrant( Thread_Params * info )
+{
+	//get updated_parameters
+	Thread_Params add_area = *info;
+
+	CML_int * Removed = &(*(add_area.Add_Resize)).removed;
+	CML_color * Image = &(*(add_area.Source)).image;
+	CML_int * Weight = &(*(add_area.Source)).weight;
+
+	int width = add_area.old_size;
+	for(int y = add_area.top_y; y < add_area.bot_y; y++)
+	{
+		int * removed = (*Removed).Row(y);
+		CML_RGBA * pixels = (*Image).Row(y);
+		int * weights = (*Weight).Row(y);
+
+		int add_column = (*Image).Width() - 1;
+		for(int x = width - 1; x >= 0; x--)
+		{
+			if(removed[x] != 0)
+			{
+				//insert a new pixel, taking the average of the current pixel and the next pixel
+				//(the next pixel hasn't moved yet, or was moved onto itself, since nothing was inserted to its left)
+				int next = MIN(x+1,width-1);
+				pixels[add_column] = Average_Pixels( pixels[x], pixels[next] );
+				weights[add_column] = (weights[x] + weights[next]) / 2;
+				add_column--;
+			}
+
+			//move the pixel over to its place in the large image
+			pixels[add_column] = pixels[x];
+			weights[add_column] = weights[x];
+			add_column--;
+		}
+	}
+}
+
+
+//=========================================================================================================//
+//Resize_img has the removed flags from CAIR_Remove(), and Source has the original image and weights at the start of rows that
+//are already goal_x long. Enlarge them in place, then give Source back the planes Resize_img borrowed, at the new size.
+void Add_Path( CAIR_Context * context, CML_image * Resize_img, CML_image * Source, int width )
+{
+	double start = Stats_Start( context );
+	int height = (*Source).Height();
+	int goal_x = (*Source).Width();
+	int thread_height = height / context->num_threads;
+
+	//setup parameters
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].Add_Resize = Resize_img;
+		context->thread_info[i].old_size = width;
+		context->thread_info[i].top_y = i * thread_height;
+		context->thread_info[i].bot_y = context->thread_info[i].top_y + thread_height;
+	}
+
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_y = height;
+
+	//now build the enlarged image
+	Run_Threads( context, Add_Quadrant );
+
+	//the other planes get rebuilt by the next pass anyway
+	(*Source).gray.Swap( (*Resize_img).gray );
+	(*Source).edge.Swap( (*Resize_img).edge );
+	(*Source).energy.Swap( (*Resize_img).energy );
+	(*Source).gray.D_Resize(goal_x, height);
+	(*Source).edge.D_Resize(goal_x, height);
+	(*Source).energy.D_Resize(goal_x, height);
+	(*Source).track_removed = false;
+	(*Source).track_h_energy = false;
+
+	Stats_Seams( context, goal_x - width );
+	Stats_Stop( context, STAGE_ADD, start );
+	Stats_Memory( context, Resize_img, Source );
+} //end Add_Path()
+
+//forward delcration
+bool CAIR_Remove( CAIR_Context * context, CML_image * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done );
+
+//=========================================================================================================//
+//Enlarge Source to the width specified in goal_x. This is accomplished by remove the number of seams
+//that are to be added, and recording what pixels were removed. We then add a new pixel next to the origional.
+//The removal blends pixels as it goes, so it works on Resize_img, which takes over Source's planes rather than copying them.
+//Source gets its image and weights back in planes that are goal_x wide from the start, so the pixels can be inserted in place.
+bool CAIR_Add( CAIR_Context * context, CML_image * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
+{
+	int width = (*Source).Width();
+	int height = (*Source).Height();
+
+	//we will resize this image down the number of adds in order to determine which pixels were removed
+	CML_image Resize_img(1,1);
+	Resize_img.image.Swap( (*Source).image );
+	Resize_img.weight.Swap( (*Source).weight );
+	Resize_img.gray.Swap( (*Source).gray );
+	Resize_img.edge.Swap( (*Source).edge );
+	Resize_img.energy.Swap( (*Source).energy );
+	Resize_img.gray.D_Resize( width, height );
+	Resize_img.edge.D_Resize( width, height );
+	Resize_img.energy.D_Resize( width, height );
+	Resize_img.Track_Removed();
+
+	//the only copy: the originals, into the start of the enlarged rows
+	(*Source).image.D_Resize( goal_x, height );
+	(*Source).weight.D_Resize( goal_x, height );
+	for( int y = 0; y < height; y++ )
+	{
+		std::memcpy( (*Source).image.Row(y), Resize_img.image.Row(y), width*sizeof(CML_RGBA) );
+		std::memcpy( (*Source).weight.Row(y), Resize_img.weight.Row(y), width*sizeof(int) );
+	}
+
+	//remove all the least energy seams, setting the "removed" flag for each element
+	if(CAIR_Remove(context, &Resize_img, width - (goal_x - width), conv, ener, CAIR_callback, total_seams, seams_done) == false)
+	{
+		return false;
+	}
+
+	//enlarge the image now that we have our seam data
+	Add_Path(context, &Resize_img, Source, width);
+
+	return true;
+} //end CAIR_Add()
+
+//=========================================================================================================//
+//==                                             R E M O V E                                             ==//
+//=========================================================================================================//
+
+//=========================================================================================================//
+//more multi-threaded goodness
+//the areas are not quadrants, rather, more like strips, but I keep the name convention
+void Remove_Quadrant( Thread_Params * info )
+{
+	//get updated parameters
+	Thread_Params remove_area = *info;
+
+	CML_image * Source = remove_area.Source;
+	CML_color * Image = &(*Source).image;
+	CML_gray * Gray = &(*Source).gray;
+	CML_int * Weight = &(*Source).weight;
+	int width = remove_area.old_size; //Remove_Path() has already cut the width down
+
+	//remove
+	for( int y = remove_area.top_y; y < remove_area.bot_y; y++ )
+	{
+		//reduce each row by one, the removed pixel
+		int remove = (remove_area.Path)[y];
+		if( (*Source).track_removed == true )
+		{
+			(*Source).removed( (*Source).column(remove,y), y ) = width;
+		}
+
+		//now, bounds check the assignments
+		if( (remove - 1) > 0 )
+		{
+			if( (*Weight)(remove,y) >= 0 ) //otherwise area marked for removal, don't blend
+			{
+				//average removed pixel back in
+				(*Image)(remove-1,y) = Average_Pixels( (*Image)(remove,y), (*Image).Get(remove-1,y) );
+			}
+			(*Gray)(remove-1,y) = Grayscale_Pixel( &(*Image)(remove-1,y) );
+		}
+
+		if( (remove + 1) < width )
+		{
+			if( (*Weight)(remove,y) >= 0 ) //otherwise area marked for removal, don't blend
+			{
+				//average removed pixel back in
+				(*Image)(remove+1,y) = Average_Pixels( (*Image)(remove,y), (*Image)(remove+1,y) );
+			}
+			(*Gray)(remove+1,y) = Grayscale_Pixel( &(*Image)(remove+1,y) );
+		}
+
+		//close the gap, from whichever side is closer
+		(*Source).Remove_From_Row( remove, y, width );
+	}
+} //end Remove_Quadrant()
+
+//=========================================================================================================//
+//Second half of the removal, for rows top_y to bot_y. This must wait until the grayscale values are corrected in the rows
+//above and below. width is the width after the removal.
+void Remove_Edge_Rows( CML_image * Source, int * Path, CAIR_convolution conv, int width, int top_y, int bot_y )
+{
+	//now update the edge values after the grayscale values have been corrected
+	int height = (*Source).Height();
+	for(int y = top_y; y < bot_y; y++)
+	{
+		int remove = Path[y];
+		edge_safe safety = UNSAFE;
+
+		//check to see if we might fall out of the image during a Convolve_Pixel() with a 3x3 kernel
+		if( (y<=4) || (y>=height-5) || (remove<=4) || (remove>=width-5) )
+		{
+			safety = SAFE;
+		}
+
+		//rebuild the edges around the removed seam, assuming no larger than a 3x3 kernel was used
+		//The grayscale for the current seam location (remove) and its neighbor to the left (remove-1) were directly changed when the
+		//seam pixel was blended back into it. Therefore we need to update any edge value that could be affected. The kernels CAIR uses
+		//are no more than 3x3 so we would need to update at least up to one pixel on either side of the changed grayscales. But, since
+		//the seams can cut back into an area above or below the row we're currently on, other areas beyond our one pixel area could change.
+		//Therefore we have to increase the number of edge values that are updated.
+		for(int x = remove-3; x < remove+3; x++)
+		{
+			//safe/unsafe check above should make Convolve_Pixel() happy, but do a min/max check on the x to be sure it's happy
+			(*Source).edge(MIN(MAX(x,0),width-1),y) = Convolve_Pixel(&(*Source).gray, MIN(MAX(x,0),width-1), y, safety, conv);
+		}
+	}
+} //end Remove_Edge_Rows()
+
+//=========================================================================================================//
+//Both halves of the removal in a single job, so Remove_Path() only has to sync with the threads once per seam.
+//The edges of the first and last rows of the strip need the rows next door, which belong to other threads, so those two rows
+//are left for Remove_Path() to do once everyone is back.
+void Remove_Fused_Quadrant( Thread_Params * info )
+{
+	Remove_Quadrant( info );
+	Remove_Edge_Rows( (*info).Source, (*info).Path, (*info).conv, (*(*info).Source).Width(), (*info).top_y + 1, (*info).bot_y - 1 );
+} //end Remove_Fused_Quadrant()
+
+//=========================================================================================================//
+//Is Source small enough that waking the threads up costs more than the work they would do? See CAIR_SERIAL_REMOVE.
+bool Remove_Serial( CAIR_Context * context, CML_image * Source )
+{
+	return ( context->num_threads == 1 ) || ( (*Source).Width() * (*Source).Height() < CAIR_SERIAL_REMOVE );
+}
+
+//=========================================================================================================//
+//Remove a seam from Source. Blend the seam's image and weight back into the Source. Update edges, grayscales,
+//and set corresponding removed flags.
+void Remove_Path( CAIR_Context * context, CML_image * Source, int * Path, CAIR_convolution conv )
+{
+	double start = Stats_Start( context );
+	int width = (*Source).Width();
+	int height = (*Source).Height();
+	bool serial = Remove_Serial( context, Source );
+
+	//cut the width down first, so the edges can be rebuilt as soon as a strip's grayscale is done
+	(*Source).Resize_Width( width - 1 );
+
+	if( serial == true )
+	{
+		Thread_Params remove_area;
+		remove_area.Source = Source;
+		remove_area.Path = Path;
+		remove_area.old_size = width;
+		remove_area.top_y = 0;
+		remove_area.bot_y = height;
+		Remove_Quadrant( &remove_area );
+		Remove_Edge_Rows( Source, Path, conv, width - 1, 0, height );
+
+		Stats_Seams( context, 1 );
+		Stats_Stop( context, STAGE_REMOVE, start );
+		return;
+	}
+
+	int thread_height = height / context->num_threads;
+
+	//setup parameters
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].Path = Path;
+		context->thread_info[i].conv = conv;
+		context->thread_info[i].old_size = width;
+		context->thread_info[i].top_y = i * thread_height;
+		context->thread_info[i].bot_y = context->thread_info[i].top_y + thread_height;
+	}
+
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_y = height;
+
+	//start the threads and wait on them
+	Run_Threads( context, Remove_Fused_Quadrant );
+
+	//and pick up the edges where the strips meet
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		int top_y = context->thread_info[i].top_y;
+		int bot_y = context->thread_info[i].bot_y;
+		if( top_y < bot_y )
+		{
+			Remove_Edge_Rows( Source, Path, conv, width - 1, top_y, top_y + 1 );
+		}
+		if( bot_y - 1 > top_y )
+		{
+			Remove_Edge_Rows( Source, Path, conv, width - 1, bot_y - 1, bot_y );
+		}
+	}
+
+	Stats_Seams( context, 1 );
+	Stats_Stop( context, STAGE_REMOVE, start );
+} //end Remove_Path()
+
+//=========================================================================================================//
+//Horizontal seam version of Remove_Quadrant(), working on the columns top_x to bot_x of the untransposed image.
+//Path[x] is the row to remove from column x. The pixels above and below get blended just like the left and right ones
+//would in a transposed image, then the rest of each column is moved up. That is done a row at a time so it streams through memory.
+void Remove_H_Quadrant( Thread_Params * info )
+{
+	//get updated parameters
+	Thread_Params remove_area = *info;
+
+	CML_image * Source = remove_area.Source;
+	CML_color * Image = &(*Source).image;
+	CML_gray * Gray = &(*Source).gray;
+	CML_int * Edge = &(*Source).edge;
+	CML_int * Weight = &(*Source).weight;
+	int * Path = remove_area.Path;
+	int height = remove_area.old_size; //Remove_H_Path() has already cut the height down
+	int top_remove = height;
+
+	for( int x = remove_area.top_x; x < remove_area.bot_x; x++ )
+	{
+		int remove = Path[x];
+		top_remove = MIN( top_remove, remove );
+
+		if( (remove - 1) > 0 )
+		{
+			if( (*Weight)(x,remove) >= 0 ) //otherwise area marked for removal, don't blend
+			{
+				(*Image)(x,remove-1) = Average_Pixels( (*Image)(x,remove), (*Image)(x,remove-1) );
+			}
+			(*Gray)(x,remove-1) = Grayscale_Pixel( &(*Image)(x,remove-1) );
+		}
+
+		if( (remove + 1) < height )
+		{
+			if( (*Weight)(x,remove) >= 0 ) //otherwise area marked for removal, don't blend
+			{
+				(*Image)(x,remove+1) = Average_Pixels( (*Image)(x,remove), (*Image)(x,remove+1) );
+			}
+			(*Gray)(x,remove+1) = Grayscale_Pixel( &(*Image)(x,remove+1) );
+		}
+
+		//the horizontal energy is stored transposed, so column x is a row there
+		if( (*Source).track_h_energy == true )
+		{
+			(*Source).h_energy.Remove_From_Row( remove, x, height );
+		}
+	}
+
+	//move everyone below the seam up one
+	for( int y = top_remove; y < height - 1; y++ )
+	{
+		for( int x = remove_area.top_x; x < remove_area.bot_x; x++ )
+		{
+			if( y >= Path[x] )
+			{
+				(*Image)(x,y) = (*Image)(x,y+1);
+				(*Gray)(x,y) = (*Gray)(x,y+1);
+				(*Edge)(x,y) = (*Edge)(x,y+1);
+				(*Weight)(x,y) = (*Weight)(x,y+1);
+			}
+		}
+	}
+}
+
+//=========================================================================================================//
+//Horizontal seam version of Remove_Edge_Rows(), for columns top_x to bot_x. The edges are rebuilt in the transposed orientation,
+//as they would be in a transposed image. height is the height after the removal.
+void Remove_H_Edge_Columns( CML_image * Source, int * Path, CAIR_convolution conv, int height, int top_x, int bot_x )
+{
+	CML_Transposed<CML_byte> Gray( &(*Source).gray );
+	CML_Transposed<int> Edge( &(*Source).edge );
+	int width = height; //transposed
+	height = Gray.Height();
+
+	for( int y = top_x; y < bot_x; y++ )
+	{
+		int remove = Path[y];
+		edge_safe safety = UNSAFE;
+
+		//check to see if we might fall out of the image during a Convolve_Pixel() with a 3x3 kernel
+		if( (y<=4) || (y>=height-5) || (remove<=4) || (remove>=width-5) )
+		{
+			safety = SAFE;
+		}
+
+		for( int x = remove-3; x < remove+3; x++ )
+		{
+			Edge(MIN(MAX(x,0),width-1),y) = Convolve_Pixel( &Gray, MIN(MAX(x,0),width-1), y, safety, conv );
+		}
+	}
+}
+
+//=========================================================================================================//
+//Horizontal seam version of Remove_Fused_Quadrant().
+void Remove_H_Fused_Quadrant( Thread_Params * info )
+{
+	Remove_H_Quadrant( info );
+	Remove_H_Edge_Columns( (*info).Source, (*info).Path, (*info).conv, (*(*info).Source).Height(), (*info).top_x + 1, (*info).bot_x - 1 );
+}
+
+//=========================================================================================================//
+//Remove a horizontal seam from Source without transposing it. Works like Remove_Path() would on a transposed Source.
+//The vertical energy is left alone, so the rows from the top of the seam down need a recalculation, see Energy_Map_Rows().
+void Remove_H_Path( CAIR_Context * context, CML_image * Source, int * Path, CAIR_convolution conv )
+{
+	double start = Stats_Start( context );
+	int width = (*Source).Width();
+	int height = (*Source).Height();
+	bool serial = Remove_Serial( context, Source );
+
+	(*Source).Resize_Height( height - 1 );
+
+	if( serial == true )
+	{
+		Thread_Params remove_area;
+		remove_area.Source = Source;
+		remove_area.Path = Path;
+		remove_area.old_size = height;
+		remove_area.top_x = 0;
+		remove_area.bot_x = width;
+		Remove_H_Quadrant( &remove_area );
+		Remove_H_Edge_Columns( Source, Path, conv, height - 1, 0, width );
+
+		Stats_Seams( context, 1 );
+		Stats_Stop( context, STAGE_REMOVE, start );
+		return;
+	}
+
+	int thread_width = width / context->num_threads;
+
+	//setup parameters
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		context->thread_info[i].Source = Source;
+		context->thread_info[i].Path = Path;
+		context->thread_info[i].conv = conv;
+		context->thread_info[i].old_size = height;
+		context->thread_info[i].top_x = i * thread_width;
+		context->thread_info[i].bot_x = context->thread_info[i].top_x + thread_width;
+	}
+
+	//have the last thread pick up the slack
+	context->thread_info[context->num_threads-1].bot_x = width;
+
+	Run_Threads( context, Remove_H_Fused_Quadrant );
+
+	//the edges where the strips meet
+	for( int i = 0; i < context->num_threads; i++ )
+	{
+		int top_x = context->thread_info[i].top_x;
+		int bot_x = context->thread_info[i].bot_x;
+		if( top_x < bot_x )
+		{
+			Remove_H_Edge_Columns( Source, Path, conv, height - 1, top_x, top_x + 1 );
+		}
+		if( bot_x - 1 > top_x )
+		{
+			Remove_H_Edge_Columns( Source, Path, conv, height - 1, bot_x - 1, bot_x );
+		}
+	}
+
+	Stats_Seams( context, 1 );
+	Stats_Stop( context, STAGE_REMOVE, start );
+}
+
+//=========================================================================================================//
+//Removes several seams at once, see Energy_Paths(). Each row has its seams blended into their neighbors the same way as
+//Remove_Quadrant(), then every plane is compacted in one pass.
+void Remove_Paths_Quadrant( Thread_Params * info )
+{
+	//get updated parameters
+	Thread_Params remove_area = *info;
+
+	CML_image * Source = remove_area.Source;
+	CML_color * Image = &(*Source).image;
+	CML_gray * Gray = &(*Source).gray;
+	CML_int * Weight = &(*Source).weight;
+	int seams = remove_area.seams;
+	int width = (*Image).Width();
+
+	for( int y = remove_area.top_y; y < remove_area.bot_y; y++ )
+	{
+		int * remove = &(remove_area.Path[y*seams]);
+
+		//the seams are still in order of energy here, so they get removed at one width each
+		if( (*Source).track_removed == true )
+		{
+			for( int s = 0; s < seams; s++ )
+			{
+				(*Source).removed( (*Source).column(remove[s],y), y ) = width - s;
+			}
+		}
+		std::sort( remove, remove + seams );
+
+		for( int s = 0; s < seams; s++ )
+		{
+			int x = remove[s];
+
+			if( (*Weight)(x,y) >= 0 ) //otherwise area marked for removal, don't blend
+			{
+				//average removed pixel back in
+				if( (x - 1) > 0 )
+				{
+					(*Image)(x-1,y) = Average_Pixels( (*Image)(x,y), (*Image)(x-1,y) );
+				}
+				if( (x + 1) < width )
+				{
+					(*Image)(x+1,y) = Average_Pixels( (*Image)(x,y), (*Image)(x+1,y) );
+				}
+			}
+		}
+
+		//now that the blending is done, fix up the neighbors' grayscale
+		for( int s = 0; s < seams; s++ )
+		{
+			int x = remove[s];
+			if( (x - 1) > 0 )
+			{
+				(*Gray)(x-1,y) = Grayscale_Pixel( &(*Image)(x-1,y) );
+			}
+			if( (x + 1) < width )
+			{
+				(*Gray)(x+1,y) = Grayscale_Pixel( &(*Image)(x+1,y) );
+			}
+		}
+
+		(*Source).Remove_Columns( y, remove, seams );
+	}
+}
 
 //=========================================================================================================//
-//Enlarge Source (and Source_ptr) to the width specified in goal_x. This is accomplished by remove the number of seams
-//that are to be added, and recording what pixels were removed. We then add a new pixel next to the origional.
-bool CAIR_Add( CML_image * Source, CML_image_ptr * Source_ptr, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
+//Remove the seams found by Energy_Paths() from Source. Since the seams cover much of the image, the edges are redone in full.
+void Remove_Paths( CAIR_Context * context, CML_image * Source, int * Paths, int seams, CAIR_convolution conv )
 {
-	//create local copies of the actual source image and its set of pointers
-	//we will resize this image down the number of adds in order to determine which pixels were removed
-	CML_image Resize_img((*Source_ptr).Width(),(*Source_ptr).Height());
-	CML_image_ptr Resize_img_ptr((*Source_ptr).Width(),(*Source_ptr).Height());
-	for(int y = 0; y < (*Source_ptr).Height(); y++)
+	double start = Stats_Start( context );
+	int thread_height = (*Source).Height() / context->num_threads;
+
+	if( Remove_Serial( context, Source ) == true )
+	{
+		Thread_Params remove_area;
+		remove_area.Source = Source;
+		remove_area.Path = Paths;
+		remove_area.seams = seams;
+		remove_area.top_y = 0;
+		remove_area.bot_y = (*Source).Height();
+		Remove_Paths_Quadrant( &remove_area );
+	}
+	else
+	{
+		//setup parameters
+		for( int i = 0; i < context->num_threads; i++ )
+		{
+			context->thread_info[i].Source = Source;
+			context->thread_info[i].Path = Paths;
+			context->thread_info[i].seams = seams;
+			context->thread_info[i].top_y = i * thread_height;
+			context->thread_info[i].bot_y = context->thread_info[i].top_y + thread_height;
+		}
+
+		//have the last thread pick up the slack
+		context->thread_info[context->num_threads-1].bot_y = (*Source).Height();
+
+		Run_Threads( context, Remove_Paths_Quadrant );
+	}
+
+	(*Source).Resize_Width( (*Source).Width() - seams );
+	Stats_Seams( context, seams );
+	Stats_Stop( context, STAGE_REMOVE, start );
+
+	Edge_Detect( context, Source, conv );
+}
+
+//=========================================================================================================//
+//How many seams to take from the next energy map, with removes seams left to go.
+int Seams_Per_Pass( CAIR_Context * context, int width, int removes )
+{
+	int seams = context->seams;
+	if( seams == CAIR_ADAPTIVE_SEAMS )
+	{
+		seams = width / 32;
+	}
+	return MAX( MIN( seams, removes ), 1 );
+}
+
+//=========================================================================================================//
+//The seam loop of CAIR_Remove(), for callers that keep Source's grayscale and edges up to date themselves.
+//The energy map is built fresh for the first seam, unless kept_map says Source's map is still the one the last seam removed
+//(left in Scratch_Path() 0) came from. Then it is only updated around that seam, which comes out the same as a fresh map with
+//backward energy, but not with forward energy (see Energy_Map()). single takes one seam at a time whatever CAIR_Seams() says.
+bool Remove_Seams( CAIR_Context * context, CML_image * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done, bool single, bool kept_map )
+{
+	int removes = (*Source).Width() - goal_x;
+	bool first_time = ( kept_map == false );
+
+	//remove each seam
+	for( int i = 0; i < removes; )
+	{
+		//If you're going to maintain some sort of progress counter/bar, here's where you would do it!
+		if( (CAIR_callback != NULL) && (CAIR_callback( (float)(i+seams_done)/total_seams ) == false) )
+		{
+			return false;
+		}
+
+		int seams = single ? 1 : Seams_Per_Pass( context, (*Source).Width(), removes - i );
+		if( seams > 1 )
+		{
+			//pull several seams out of a fresh energy map and remove them together
+			int * Paths = Scratch_Path( context, 0, seams * (*Source).Height() );
+			seams = Energy_Paths( context, Source, Paths, seams, ener );
+			Remove_Paths( context, Source, Paths, seams, conv );
+			first_time = true;
+		}
+		else
+		{
+			//determine the least energy path
+			//first time through, build the energy map, otherwise only update the energy map from the last remove
+			int * Min_Path = Scratch_Path( context, 0, (*Source).Height() );
+			Energy_Path( context, Source, Min_Path, ener, first_time );
+			first_time = false;
+
+			//remove the seam from the image, update grayscale and edge values
+			Remove_Path( context, Source, Min_Path, conv );
+		}
+		i += seams;
+	}
+
+	return true;
+} //end Remove_Seams()
+
+//=========================================================================================================//
+//Remove_Seams() for object removal, where the seams only have to be the best ones within a band of columns around the marked
+//area, left to right. The energy map is only built inside the band, which reaches margin columns past the area on each side.
+//When the best seam runs along an edge of the band that isn't the edge of the image, the band is doubled and the seam found again.
+bool Remove_Band_Seams( CAIR_Context * context, CML_image * Source, int goal_x, int left, int right, int margin, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
+{
+	int removes = (*Source).Width() - goal_x;
+	int height = (*Source).Height();
+
+	for( int i = 0; i < removes; i++ )
+	{
+		if( (CAIR_callback != NULL) && (CAIR_callback( (float)(i+seams_done)/total_seams ) == false) )
+		{
+			return false;
+		}
+
+		int width = (*Source).Width();
+		int * Path = Scratch_Path( context, 0, height );
+		int band_left, band_right;
+		bool touches;
+		do
+		{
+			band_left = MAX( left - margin, 0 );
+			band_right = MIN( right + margin, width - 1 );
+			int band_width = band_right - band_left + 1;
+
+			Energy_Band_Map( context, Source, ener, band_left, band_right );
+
+			CML_Band<int> Energy( &(*Source).energy, band_left, band_width );
+			double start = Stats_Start( context );
+			Least_Path( &Energy, Path );
+			Stats_Stop( context, STAGE_PATH, start );
+
+			//a seam along the edge of the band might have done better outside of it
+			touches = false;
+			for( int y = 0; y < height; y++ )
+			{
+				if( ((band_left > 0) && (Path[y] == 0)) || ((band_right < width - 1) && (Path[y] == band_width - 1)) )
+				{
+					touches = true;
+					break;
+				}
+			}
+			if( touches == true )
+			{
+				margin = MAX( margin * 2, 1 );
+			}
+		} while( touches == true );
+
+		int path_min = width;
+		int path_max = 0;
+		for( int y = 0; y < height; y++ )
+		{
+			Path[y] += band_left;
+			path_min = MIN( path_min, Path[y] );
+			path_max = MAX( path_max, Path[y] );
+		}
+		Remove_Path( context, Source, Path, conv );
+
+		//keep the marked area inside left to right: its rows move over wherever the seam went through them or to their left
+		if( path_min < left )
+		{
+			left--;
+		}
+		if( path_max <= right )
+		{
+			right--;
+		}
+		right = MAX( right, left );
+	}
+
+	return true;
+} //end Remove_Band_Seams()
+
+//=========================================================================================================//
+//Removes all requested vertical paths form the image.
+bool CAIR_Remove( CAIR_Context * context, CML_image * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
+{
+	//setup the images
+	Grayscale_Image( context, Source );
+	Edge_Detect( context, Source, conv );
+
+	return Remove_Seams( context, Source, goal_x, conv, ener, CAIR_callback, total_seams, seams_done, false, false );
+} //end CAIR_Remove()
+
+//=========================================================================================================//
+//Adds seams to Image until it is goal_x by goal_y, first the width and then the height. Neither can be smaller than Image.
+bool Enlarge_Image( CAIR_Context * context, CML_image * Image, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
+{
+	int width = (*Image).Width();
+	int height = (*Image).Height();
+
+	if( goal_x > width )
+	{
+		//increase width
+		if( CAIR_Add( context, Image, goal_x, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		{
+			return false;
+		}
+		seams_done += goal_x - width;
+	}
+
+	if( goal_y > height )
+	{
+		//increase height
+		//works like above, except hand it a rotated image
+		double start = Stats_Start( context );
+		CML_image TImage(1,1);
+		TImage.Transpose(Image);
+		Stats_Stop( context, STAGE_TRANSPOSE, start );
+		Stats_Memory( context, Image, &TImage );
+
+		if( CAIR_Add( context, &TImage, goal_y, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		{
+			return false;
+		}
+		
+		//store back the transposed info
+		start = Stats_Start( context );
+		(*Image).Transpose(&TImage);
+		Stats_Stop( context, STAGE_TRANSPOSE, start );
+	}
+
+	return true;
+} //end Enlarge_Image()
+
+//=========================================================================================================//
+//store the provided image and weights into a CML_image
+void Init_CML_Image(CML_color * Source, CML_int * S_Weights, CML_image * Image)
+{
+	int x = (*Source).Width();
+	int y = (*Source).Height(); //S_Weights should match
+
+	(*Image).D_Resize(x,y);
+	(*Image).image = (*Source);
+	(*Image).weight = (*S_Weights);
+}
+
+//=========================================================================================================//
+//pull the resized image and weights back out of the CML_image
+void Extract_CML_Image(CML_image * Image, CML_color * Dest, CML_int * D_Weights)
+{
+	(*Dest) = (*Image).image;
+	(*D_Weights) = (*Image).weight;
+}
+
+
+//=========================================================================================================//
+//Set the number of threads that CAIR should use. Minimum of 1 required.
+//WARNING: Never call this function while CAIR() is processing an image, otherwise bad things will happen!
+void CAIR_Threads( int thread_count )
+{
+	CAIR_Threads( &default_context, thread_count );
+}
+
+//=========================================================================================================//
+//Same as above, but only for the given context.
+void CAIR_Threads( CAIR_Context * context, int thread_count )
+{
+	if( thread_count < 1 )
+	{
+		context->num_threads = 1;
+	}
+	else
+	{
+		context->num_threads = thread_count;
+	}
+}
+
+//=========================================================================================================//
+//Set how many seams are taken from each energy map. See CAIR.h.
+void CAIR_Seams( int seams )
+{
+	CAIR_Seams( &default_context, seams );
+}
+
+//=========================================================================================================//
+//Same as above, but only for the given context.
+void CAIR_Seams( CAIR_Context * context, int seams )
+{
+	if( seams < 0 )
+	{
+		context->seams = 1;
+	}
+	else
+	{
+		context->seams = seams;
+	}
+}
+
+//=========================================================================================================//
+//Set how far past the marked area CAIR_Removal() looks for seams. See CAIR.h.
+void CAIR_Removal_Band( int margin )
+{
+	CAIR_Removal_Band( &default_context, margin );
+}
+
+//=========================================================================================================//
+//Same as above, but only for the given context.
+void CAIR_Removal_Band( CAIR_Context * context, int margin )
+{
+	context->removal_band = MAX( margin, 0 );
+}
+
+//=========================================================================================================//
+//Pick the SIMD kernels, as long as the CPU can run them. See CAIR.h.
+void CAIR_Set_SIMD( CAIR_simd level )
+{
+	pthread_once( &simd_once, Init_SIMD ); //so the first look can't come along afterwards and undo this
+	simd_level.store( MAX( MIN( (int)level, (int)Detect_SIMD() ), (int)CAIR_SCALAR ) );
+}
+
+//=========================================================================================================//
+//The SIMD kernels in use.
+CAIR_simd CAIR_Get_SIMD()
+{
+	return (CAIR_simd)SIMD_Level();
+}
+
+//=========================================================================================================//
+//The name CAIR_SIMD uses for level.
+const char * CAIR_SIMD_Name( CAIR_simd level )
+{
+	switch( level )
+	{
+	case CAIR_SIMD_SSE2:
+		return "sse2";
+	case CAIR_SIMD_AVX2:
+		return "avx2";
+	case CAIR_SIMD_AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+//=========================================================================================================//
+//Create a new context with its own threads and buffers.
+CAIR_Context * CAIR_Create_Context( int thread_count )
+{
+	return new CAIR_Context( thread_count );
+}
+
+//=========================================================================================================//
+//Destroy a context made by CAIR_Create_Context().
+void CAIR_Destroy_Context( CAIR_Context * context )
+{
+	delete context;
+}
+
+//=========================================================================================================//
+//Start adding up stats in stats, clearing it first. NULL stops collecting them.
+void CAIR_Collect_Stats( CAIR_Context * context, CAIR_Stats * stats )
+{
+	if( stats != NULL )
+	{
+		for( int i = 0; i < CAIR_STAGES; i++ )
+		{
+			(*stats).seconds[i] = 0;
+		}
+		(*stats).seams = 0;
+		(*stats).energy_cells = 0;
+		(*stats).energy_cells_full = 0;
+		(*stats).syncs = 0;
+		(*stats).sync_seconds = 0;
+		(*stats).imbalance_seconds = 0;
+		(*stats).peak_bytes = 0;
+	}
+	context->stats = stats;
+}
+
+//=========================================================================================================//
+//Same as above, using the default context.
+void CAIR_Collect_Stats( CAIR_Stats * stats )
+{
+	CAIR_Collect_Stats( &default_context, stats );
+}
+
+//=========================================================================================================//
+//==                                          F R O N T E N D                                            ==//
+//=========================================================================================================//
+//The Great CAIR Frontend. This baby will retarget Source using S_Weights into the dimensions supplied by goal_x and goal_y into D_Weights and Dest.
+//Weights allows for an area to be biased for removal/protection. A large positive value will protect a portion of the image,
+//and a large negative value will remove it. Do not exceed the limits of int's, as this will cause an overflow. I would suggest
+//a safe range of -2,000,000 to 2,000,000 (this is a maximum guideline, much smaller weights will work just as well for most images).
+//Weights must be the same size as Source. D_Weights will contain the weights of Dest after the resize. Dest is the output,
+//and as such has no constraints (its contents will be destroyed, just so you know). 
+//The internal order is this: remove horizontal, remove vertical, add horizontal, add vertical.
+//CAIR can use multiple convolution methods to determine the image energy. 
+//Prewitt and Sobel are close to each other in results and represent the "traditional" edge detection.
+//V_SQUARE and V1 can produce some of the better quality results, but may remove from large objects to do so. Do note that V_SQUARE
+//produces much larger edge values, any may require larger weight values (by about an order of magnitude) for effective operation.
+//Laplacian is a second-derivative operator, and can limit some artifacts while generating others.
+//CAIR also can use the new improved energy algorithm called "forward energy." Removing seams can sometimes add energy back to the image
+//by placing nearby edges directly next to each other. Forward energy can get around this by determining the future cost of a seam.
+//Forward energy removes most serious artifacts from a retarget, but is slightly more costly in terms of performance.
+bool CAIR( CAIR_Context * context, CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+{
+	//if no change, then just copy to the source to the destination
+	if( (goal_x == (*Source).Width()) && (goal_y == (*Source).Height() ) )
+	{
+		(*Dest) = (*Source);
+		(*D_Weights) = (*S_Weights);
+		return true;
+	}
+
+	//calculate the total number of operations needed
+	int total_seams = abs((*Source).Width()-goal_x) + abs((*Source).Height()-goal_y);
+	int seams_done = 0;
+
+	//make sure the threads are running
+	Startup_Threads( context );
+
+	//build the image for internal use
+	double start = Stats_Start( context );
+	CML_image Image(1,1);
+	Init_CML_Image(Source, S_Weights, &Image);
+	Stats_Stop( context, STAGE_INIT, start );
+	Stats_Memory( context, &Image, NULL );
+
+	if( goal_x < (*Source).Width() )
+	{
+		//reduce width
+		if( CAIR_Remove( context, &Image, goal_x, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		{
+			return false;
+		}
+		seams_done += abs((*Source).Width()-goal_x);
+	}
+
+	if( goal_y < (*Source).Height() )
 	{
-		for(int x = 0; x < (*Source_ptr).Width(); x++)
+		//reduce height
+		//works like above, except hand it a rotated image
+		start = Stats_Start( context );
+		CML_image TImage(1,1);
+		TImage.Transpose(&Image);
+		Stats_Stop( context, STAGE_TRANSPOSE, start );
+		Stats_Memory( context, &Image, &TImage );
+
+		if( CAIR_Remove( context, &TImage, goal_y, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
 		{
-			Resize_img(x,y).image = (*Source_ptr)(x,y)->image;
-			Resize_img(x,y).weight = (*Source_ptr)(x,y)->weight;
-			Resize_img(x,y).removed = false;
-			Resize_img_ptr(x,y) = &(Resize_img(x,y));
+			return false;
 		}
+		
+		//store back the transposed info
+		start = Stats_Start( context );
+		Image.Transpose(&TImage);
+		Stats_Stop( context, STAGE_TRANSPOSE, start );
+		seams_done += abs((*Source).Height()-goal_y);
 	}
 
-	//remove all the least energy seams, setting the "removed" flag for each element
-	if(CAIR_Remove(&Resize_img_ptr, (*Source_ptr).Width() - (goal_x - (*Source_ptr).Width()), conv, ener, CAIR_callback, total_seams, seams_done) == false)
+	//enlarge what needs it
+	if( Enlarge_Image( context, &Image, goal_x, goal_y, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
 	{
 		return false;
 	}
 
-	//enlarge the image now that we have our seam data
-	Add_Path(&Resize_img, Source, Source_ptr, goal_x);
+	//pull the image data back out
+	start = Stats_Start( context );
+	Extract_CML_Image(&Image, Dest, D_Weights);
+	Stats_Stop( context, STAGE_EXTRACT, start );
 
 	return true;
-} //end CAIR_Add()
+} //end CAIR()
 
 //=========================================================================================================//
-//==                                             R E M O V E                                             ==//
-//=========================================================================================================//
+//Same as above, using the default context.
+bool CAIR( CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+{
+	return CAIR( &default_context, Source, S_Weights, goal_x, goal_y, conv, ener, D_Weights, Dest, CAIR_callback );
+}
 
 //=========================================================================================================//
-//more multi-threaded goodness
-//the areas are not quadrants, rather, more like strips, but I keep the name convention
-void * Remove_Quadrant( void * id )
+//==                                                E X T R A S                                          ==//
+//=========================================================================================================//
+//Simple function that generates the grayscale image of Source and places the result in Dest.
+void CAIR_Grayscale( CAIR_Context * context, CML_color * Source, CML_color * Dest )
 {
-	int num = *((int *)id);
-	Thread_Params remove_area;
+	Startup_Threads( context );
 
-	while( true )
-	{
-		_sem_wait( &(remove_sem[0]) );
+	CML_int weights((*Source).Width(),(*Source).Height()); //don't care about the values
+	CML_image image(1,1);
 
-		//get updated parameters
-		remove_area = thread_info[num];
+	Init_CML_Image(Source,&weights,&image);
+	Grayscale_Image( context, &image );
 
-		if( remove_area.exit == true )
-		{
-			//thread is exiting
-			break;
-		}
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
 
-		//remove
-		for( int y = remove_area.top_y; y < remove_area.bot_y; y++ )
+	for( int x = 0; x < (*Source).Width(); x++ )
+	{
+		for( int y = 0; y < (*Source).Height(); y++ )
 		{
-			//reduce each row by one, the removed pixel
-			int remove = (remove_area.Path)[y];
-			(*(remove_area.Source))(remove,y)->removed = true;
+			(*Dest)(x,y).red = image.gray(x,y);
+			(*Dest)(x,y).green = image.gray(x,y);
+			(*Dest)(x,y).blue = image.gray(x,y);
+			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+		}
+	}
 
-			//now, bounds check the assignments
-			if( (remove - 1) > 0 )
-			{
-				if( (*(remove_area.Source))(remove,y)->weight >= 0 ) //otherwise area marked for removal, don't blend
-				{
-					//average removed pixel back in
-					(*(remove_area.Source))(remove-1,y)->image = Average_Pixels( (*(remove_area.Source))(remove,y)->image,
-																				 (*(remove_area.Source)).Get(remove-1,y)->image );
-				}
-				(*(remove_area.Source))(remove-1,y)->gray = Grayscale_Pixel( &(*(remove_area.Source))(remove-1,y)->image );
-			}
+}
 
-			if( (remove + 1) < (*(remove_area.Source)).Width() )
-			{
-				if( (*(remove_area.Source))(remove,y)->weight >= 0 ) //otherwise area marked for removal, don't blend
-				{
-					//average removed pixel back in
-					(*(remove_area.Source))(remove+1,y)->image = Average_Pixels( (*(remove_area.Source))(remove,y)->image,
-																				 (*(remove_area.Source)).Get(remove+1,y)->image );
-				}
-				(*(remove_area.Source))(remove+1,y)->gray = Grayscale_Pixel( &(*(remove_area.Source))(remove+1,y)->image );
-			}
+//=========================================================================================================//
+//Same as above, using the default context.
+void CAIR_Grayscale( CML_color * Source, CML_color * Dest )
+{
+	CAIR_Grayscale( &default_context, Source, Dest );
+}
 
-			//shift everyone over
-			(*(remove_area.Source)).Shift_Row( remove + 1, y, -1 );
-		}
+//=========================================================================================================//
+//Simple function that generates the edge-detection image of Source and stores it in Dest.
+void CAIR_Edge( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CML_color * Dest )
+{
+	Startup_Threads( context );
 
-		//signal that part is done
-		_sem_signal( &(remove_sem[2]) );
+	CML_int weights((*Source).Width(),(*Source).Height()); //don't care about the values
+	CML_image image(1,1);
 
-		//wait to begin edge removal
-		_sem_wait( &(remove_sem[1]) );
+	Init_CML_Image(Source,&weights,&image);
+	Grayscale_Image( context, &image);
+	Edge_Detect( context, &image, conv );
 
-		//get updated parameters
-		remove_area = thread_info[num];
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
 
-		//now update the edge values after the grayscale values have been corrected
-		int width = (*(remove_area.Source)).Width();
-		int height = (*(remove_area.Source)).Height();
-		for(int y = remove_area.top_y; y < remove_area.bot_y; y++)
+	for( int x = 0; x < (*Source).Width(); x++ )
+	{
+		for( int y = 0; y < (*Source).Height(); y++ )
 		{
-			int remove = (remove_area.Path)[y];
-			edge_safe safety = UNSAFE;
+			int value = image.edge(x,y);
 
-			//check to see if we might fall out of the image during a Convolve_Pixel() with a 3x3 kernel
-			if( (y<=4) || (y>=height-5) || (remove<=4) || (remove>=width-5) )
+			if( value > 255 )
 			{
-				safety = SAFE;
+				value = 255;
 			}
 
-			//rebuild the edges around the removed seam, assuming no larger than a 3x3 kernel was used
-			//The grayscale for the current seam location (remove) and its neighbor to the left (remove-1) were directly changed when the
-			//seam pixel was blended back into it. Therefore we need to update any edge value that could be affected. The kernels CAIR uses
-			//are no more than 3x3 so we would need to update at least up to one pixel on either side of the changed grayscales. But, since
-			//the seams can cut back into an area above or below the row we're currently on, other areas beyond our one pixel area could change.
-			//Therefore we have to increase the number of edge values that are updated.
-			for(int x = remove-3; x < remove+3; x++)
-			{
-				//safe/unsafe check above should make Convolve_Pixel() happy, but do a min/max check on the x to be sure it's happy
-				(*(remove_area.Source))(MIN(MAX(x,0),width-1),y)->edge = Convolve_Pixel(remove_area.Source, MIN(MAX(x,0),width-1), y, safety, remove_area.conv);
-			}
+			(*Dest)(x,y).red = (CML_byte)value;
+			(*Dest)(x,y).green = (CML_byte)value;
+			(*Dest)(x,y).blue = (CML_byte)value;
+			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
 		}
+	}
 
-		//signal we're now done
-		_sem_signal( &(remove_sem[2]) );
-	} //end while( true )
-
-	return NULL;
-} //end Remove_Quadrant()
+}
 
 //=========================================================================================================//
-//Remove a seam from Source. Blend the seam's image and weight back into the Source. Update edges, grayscales,
-//and set corresponding removed flags.
-void Remove_Path( CML_image_ptr * Source, int * Path, CAIR_convolution conv )
+//Same as above, using the default context.
+void CAIR_Edge( CML_color * Source, CAIR_convolution conv, CML_color * Dest )
 {
-	int thread_height = (*Source).Height() / num_threads;
-
-	//setup parameters
-	for( int i = 0; i < num_threads; i++ )
-	{
-		thread_info[i].Source = Source;
-		thread_info[i].Path = Path;
-		thread_info[i].conv = conv;
-		thread_info[i].top_y = i * thread_height;
-		thread_info[i].bot_y = thread_info[i].top_y + thread_height;
-	}
+	CAIR_Edge( &default_context, Source, conv, Dest );
+}
 
-	//have the last thread pick up the slack
-	thread_info[num_threads-1].bot_y = (*Source).Height();
+//=========================================================================================================//
+//Simple function that generates the vertical energy map of Source placing it into Dest.
+//All values are scaled down to their relative gray value. Weights are assumed all zero.
+void CAIR_V_Energy( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
+{
+	Startup_Threads( context );
 
-	//start the threads
-	for( int i = 0; i < num_threads; i++ )
-	{
-		_sem_signal( &(remove_sem[0]) );
-	}
-	//now wait on them
-	for( int i = 0; i < num_threads; i++ )
-	{
-		_sem_wait( &(remove_sem[2]) );
-	}
+	CML_int weights((*Source).Width(),(*Source).Height());
+	weights.Fill(0);
+	CML_image image(1,1);
 
-	//now we can safely resize everyone down
-	(*Source).Resize_Width( (*Source).Width() - 1 );
+	Init_CML_Image(Source,&weights,&image);
+	Grayscale_Image( context, &image);
+	Edge_Detect( context, &image, conv );
 
-	//now get the threads to handle the edge
-	//we must wait for the grayscale to be complete before we can recalculate changed edge values
-	for( int i = 0; i < num_threads; i++ )
-	{
-		_sem_signal( &(remove_sem[1]) );
-	}
+	//calculate the energy map
+	Energy_Map( context, &image, ener, NULL, false );
 
-	//now wait on them, ... again
-	for( int i = 0; i < num_threads; i++ )
+	int max_energy = 0; //find the maximum energy value
+	for( int y = 0; y < image.Height(); y++ )
 	{
-		_sem_wait( &(remove_sem[2]) );
+		for( int x = 0; x < image.Width(); x++ )
+		{
+			if( image.energy(x,y) > max_energy )
+			{
+				max_energy = image.energy(x,y);
+			}
+		}
 	}
-} //end Remove_Path()
-
-//=========================================================================================================//
-//Removes all requested vertical paths form the image.
-bool CAIR_Remove( CML_image_ptr * Source, int goal_x, CAIR_convolution conv, CAIR_energy ener, bool (*CAIR_callback)(float), int total_seams, int seams_done )
-{
-	int removes = (*Source).Width() - goal_x;
-	int * Min_Path = new int[(*Source).Height()];
-
-	//setup the images
-	Grayscale_Image( Source );
-	Edge_Detect( Source, conv );
+	
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
 
-	//remove each seam
-	for( int i = 0; i < removes; i++ )
+	for( int y = 0; y < image.Height(); y++ )
 	{
-		//If you're going to maintain some sort of progress counter/bar, here's where you would do it!
-		if( (CAIR_callback != NULL) && (CAIR_callback( (float)(i+seams_done)/total_seams ) == false) )
+		for( int x = 0; x < image.Width(); x++ )
 		{
-			delete[] Min_Path;
-			return false;
-		}
+			//scale the gray value down so we can get a realtive gray value for the energy level
+			int value = (int)(((double)image.energy(x,y) / max_energy) * 255);
+			if( value < 0 )
+			{
+				value = 0;
+			}
 
-		//determine the least energy path
-		if( i == 0 )
-		{
-			//first time through, build the energy map
-			Energy_Path( Source, Min_Path, ener, true );
-		}
-		else
-		{
-			//next time through, only update the energy map from the last remove
-			Energy_Path( Source, Min_Path, ener, false );
+			(*Dest)(x,y).red = (CML_byte)value;
+			(*Dest)(x,y).green = (CML_byte)value;
+			(*Dest)(x,y).blue = (CML_byte)value;
+			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
 		}
-
-		//remove the seam from the image, update grayscale and edge values
-		Remove_Path( Source, Min_Path, conv );
 	}
 
-	delete[] Min_Path;
-	return true;
-} //end CAIR_Remove()
+} //end CAIR_V_Energy()
 
 //=========================================================================================================//
-//Startup all threads, create all needed semaphores.
-void Startup_Threads()
+//Same as above, using the default context.
+void CAIR_V_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
 {
-	//create semaphores
-	_sem_create( &(remove_sem[0]), 0 ); //start
-	_sem_create( &(remove_sem[1]), 0 ); //edge_start
-	_sem_create( &(remove_sem[2]), 0 ); //finish
-	_sem_create( &(add_sem[0]), 0 ); //start
-	_sem_create( &(add_sem[1]), 0 ); //build_start
-	_sem_create( &(add_sem[2]), 0 ); //finish
-	_sem_create( &(edge_sem[0]), 0 ); //start
-	_sem_create( &(edge_sem[1]), 0 ); //finish
-	_sem_create( &(gray_sem[0]), 0 ); //start
-	_sem_create( &(gray_sem[1]), 0 ); //finish
+	CAIR_V_Energy( &default_context, Source, conv, ener, Dest );
+}
 
-	//create the thread handles
-	remove_threads = new pthread_t[num_threads];
-	edge_threads   = new pthread_t[num_threads];
-	gray_threads   = new pthread_t[num_threads];
-	add_threads    = new pthread_t[num_threads];
+//=========================================================================================================//
+//Simple function that generates the horizontal energy map of Source placing it into Dest.
+//All values are scaled down to their relative gray value. Weights are assumed all zero.
+void CAIR_H_Energy( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
+{
+	CML_color Tsource( 1, 1 );
+	CML_color Tdest( 1, 1 );
 
-	thread_info = new Thread_Params[num_threads];
+	Tsource.Transpose( Source );
+	CAIR_V_Energy( context, &Tsource, conv, ener, &Tdest );
 
-	//startup the threads
-	for( int i = 0; i < num_threads; i++ )
-	{
-		thread_info[i].exit = false;
-		thread_info[i].thread_num = i;
+	(*Dest).Transpose( &Tdest );
+}
 
-		pthread_create( &(remove_threads[i]), NULL, Remove_Quadrant, (void *)(&(thread_info[i].thread_num)) );
-		pthread_create( &(edge_threads[i]), NULL, Edge_Quadrant, (void *)(&(thread_info[i].thread_num)) );
-		pthread_create( &(gray_threads[i]), NULL, Gray_Quadrant, (void *)(&(thread_info[i].thread_num)) );
-		pthread_create( &(add_threads[i]), NULL, Add_Quadrant, (void *)(&(thread_info[i].thread_num)) );
-	}
+//=========================================================================================================//
+//Same as above, using the default context.
+void CAIR_H_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
+{
+	CAIR_H_Energy( &default_context, Source, conv, ener, Dest );
 }
 
 //=========================================================================================================//
-//Stops all threads. Deletes all semaphores and mutexes.
-void Shutdown_Threads()
+//Peak signal-to-noise ratio of the color channels, for comparing two results of the same size.
+double CAIR_PSNR( CML_color * First, CML_color * Second )
 {
-	//notify the threads
-	for( int i = 0; i < num_threads; i++ )
+	if( ((*First).Width() != (*Second).Width()) || ((*First).Height() != (*Second).Height()) )
 	{
-		thread_info[i].exit = true;
+		return 0;
 	}
 
-	//start them up
-	for( int i = 0; i < num_threads; i++ )
+	double error = 0;
+	for( int y = 0; y < (*First).Height(); y++ )
 	{
-		_sem_signal( &(remove_sem[0]) );
-		_sem_signal( &(add_sem[0]) );
-		_sem_signal( &(edge_sem[0]) );
-		_sem_signal( &(gray_sem[0]) );
+		for( int x = 0; x < (*First).Width(); x++ )
+		{
+			CML_RGBA a = (*First)(x,y);
+			CML_RGBA b = (*Second)(x,y);
+			error += (double)(a.red - b.red) * (a.red - b.red)
+				   + (double)(a.green - b.green) * (a.green - b.green)
+				   + (double)(a.blue - b.blue) * (a.blue - b.blue);
+		}
 	}
 
-	//wait for the joins
-	for( int i = 0; i < num_threads; i++ )
+	if( error == 0 )
 	{
-		pthread_join( remove_threads[i], NULL );
-		pthread_join( edge_threads[i], NULL );
-		pthread_join( gray_threads[i], NULL );
-		pthread_join( add_threads[i], NULL );
+		return std::numeric_limits<double>::infinity();
 	}
 
-	//remove the thread handles
-	delete[] remove_threads;
-	delete[] edge_threads;
-	delete[] gray_threads;
-	delete[] add_threads;
-
-	delete[] thread_info;
-
-	//delete the semaphores
-	_sem_destroy( &(remove_sem[0]) ); //start
-	_sem_destroy( &(remove_sem[1]) ); //edge_start
-	_sem_destroy( &(remove_sem[2]) ); //finish
-	_sem_destroy( &(add_sem[0]) ); //start
-	_sem_destroy( &(add_sem[1]) ); //build_start
-	_sem_destroy( &(add_sem[2]) ); //finish
-	_sem_destroy( &(edge_sem[0]) ); //start
-	_sem_destroy( &(edge_sem[1]) ); //finish
-	_sem_destroy( &(gray_sem[0]) ); //start
-	_sem_destroy( &(gray_sem[1]) ); //finish
+	double mse = error / (3.0 * (*First).Width() * (*First).Height());
+	return 10.0 * log10( (255.0 * 255.0) / mse );
 }
 
-
 //=========================================================================================================//
-//store the provided image and weights into a CML_image, and build a CML_image_ptr
-void Init_CML_Image(CML_color * Source, CML_int * S_Weights, CML_image * Image, CML_image_ptr * Image_ptr)
+//Counts the columns and the rows of Weights that still have a negative weight somewhere in them.
+void Count_Negatives( CML_int * Weights, int * columns, int * rows )
 {
-	int x = (*Source).Width();
-	int y = (*Source).Height(); //S_Weights should match
-
-	(*Image).D_Resize(x,y);
-	(*Image_ptr).D_Resize(x,y);
+	int width = (*Weights).Width();
+	char * negative = new char[width];
+	std::fill( negative, negative + width, 0 );
 
-	for(int j = 0; j < y; j++)
+	(*rows) = 0;
+	for( int y = 0; y < (*Weights).Height(); y++ )
 	{
-		for(int i = 0; i < x; i++)
+		int * weights = (*Weights).Row(y);
+		bool found = false;
+		for( int x = 0; x < width; x++ )
 		{
-			(*Image)(i,j).image = (*Source)(i,j);
-			(*Image)(i,j).weight = (*S_Weights)(i,j);
-
-			(*Image_ptr)(i,j) = &((*Image)(i,j));
+			if( weights[x] < 0 )
+			{
+				negative[x] = 1;
+				found = true;
+			}
+		}
+		if( found == true )
+		{
+			(*rows)++;
 		}
 	}
-}
-
-//=========================================================================================================//
-//pull the resized image and weights back out of the CML_image through the resized CML_image_ptr
-void Extract_CML_Image(CML_image_ptr * Image_ptr, CML_color * Dest, CML_int * D_Weights)
-{
-	int x = (*Image_ptr).Width();
-	int y = (*Image_ptr).Height();
 
-	(*Dest).D_Resize(x,y);
-	(*D_Weights).D_Resize(x,y);
-
-	for(int j = 0; j < y; j++)
+	(*columns) = 0;
+	for( int x = 0; x < width; x++ )
 	{
-		for(int i = 0; i < x; i++)
-		{
-			(*Dest)(i,j) = (*Image_ptr)(i,j)->image;
-			(*D_Weights)(i,j) = (*Image_ptr)(i,j)->weight;
-		}
+		(*columns) += negative[x];
 	}
+	delete[] negative;
 }
 
-
 //=========================================================================================================//
-//Set the number of threads that CAIR should use. Minimum of 1 required.
-//WARNING: Never call this function while CAIR() is processing an image, otherwise bad things will happen!
-void CAIR_Threads( int thread_count )
+//Finds the first and last columns of Weights with a negative weight in them. Leaves left and right alone if there are none.
+void Negative_Columns( CML_int * Weights, int * left, int * right )
 {
-	if( thread_count < 1 )
+	int first = (*Weights).Width();
+	int last = -1;
+	for( int y = 0; y < (*Weights).Height(); y++ )
 	{
-		num_threads = 1;
+		int * weights = (*Weights).Row(y);
+		for( int x = 0; x < first; x++ )
+		{
+			if( weights[x] < 0 )
+			{
+				first = x;
+				break;
+			}
+		}
+		for( int x = (*Weights).Width() - 1; x > last; x-- )
+		{
+			if( weights[x] < 0 )
+			{
+				last = x;
+				break;
+			}
+		}
 	}
-	else
+
+	if( last >= 0 )
 	{
-		num_threads = thread_count;
+		(*left) = first;
+		(*right) = last;
 	}
 }
 
 //=========================================================================================================//
-//==                                          F R O N T E N D                                            ==//
-//=========================================================================================================//
-//The Great CAIR Frontend. This baby will retarget Source using S_Weights into the dimensions supplied by goal_x and goal_y into D_Weights and Dest.
-//Weights allows for an area to be biased for removal/protection. A large positive value will protect a portion of the image,
-//and a large negative value will remove it. Do not exceed the limits of int's, as this will cause an overflow. I would suggest
-//a safe range of -2,000,000 to 2,000,000 (this is a maximum guideline, much smaller weights will work just as well for most images).
-//Weights must be the same size as Source. D_Weights will contain the weights of Dest after the resize. Dest is the output,
-//and as such has no constraints (its contents will be destroyed, just so you know). 
-//The internal order is this: remove horizontal, remove vertical, add horizontal, add vertical.
-//CAIR can use multiple convolution methods to determine the image energy. 
-//Prewitt and Sobel are close to each other in results and represent the "traditional" edge detection.
-//V_SQUARE and V1 can produce some of the better quality results, but may remove from large objects to do so. Do note that V_SQUARE
-//produces much larger edge values, any may require larger weight values (by about an order of magnitude) for effective operation.
-//Laplacian is a second-derivative operator, and can limit some artifacts while generating others.
-//CAIR also can use the new improved energy algorithm called "forward energy." Removing seams can sometimes add energy back to the image
-//by placing nearby edges directly next to each other. Forward energy can get around this by determining the future cost of a seam.
-//Forward energy removes most serious artifacts from a retarget, but is slightly more costly in terms of performance.
-bool CAIR( CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+//Experimental automatic object removal.
+//Any area with a negative weight will be removed. This function has three modes, determined by the choice paramater.
+//AUTO will have the function count the veritcal and horizontal rows/columns and remove in the direction that has the least.
+//VERTICAL will force the function to remove all negative weights in the veritcal direction; likewise for HORIZONTAL.
+//Because some conditions may cause the function not to remove all negative weights in one pass, max_attempts lets the function
+//go through the remoal process as many times as you're willing.
+//All the attempts work on one internal image. Its grayscale and edges follow the seams and carry over from one attempt to the
+//next, so only a change of direction (which transposes it) starts them over. With backward energy the energy map carries over
+//too, and the next attempt only updates it around the last seam. With forward energy that update isn't exact, so each attempt
+//builds a fresh map, as before. Enlarging back to the original size searches the shrunken image for its seams, as CAIR() does:
+//putting pixels back along the seams that were removed would bring them back where the object was.
+bool CAIR_Removal( CAIR_Context * context, CML_color * Source, CML_int * S_Weights, CAIR_direction choice, int max_attempts, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
 {
-	//if no change, then just copy to the source to the destination
-	if( (goal_x == (*Source).Width()) && (goal_y == (*Source).Height() ) )
-	{
-		(*Dest) = (*Source);
-		(*D_Weights) = (*S_Weights);
-		return true;
-	}
+	Startup_Threads( context );
 
-	//calculate the total number of operations needed
-	int total_seams = abs((*Source).Width()-goal_x) + abs((*Source).Height()-goal_y);
-	int seams_done = 0;
-
-	//create threads for the run
-	Startup_Threads();
+	double start = Stats_Start( context );
+	CML_image Image( 1, 1 );
+	CML_image TImage( 1, 1 );
+	Init_CML_Image( Source, S_Weights, &Image );
+	Stats_Stop( context, STAGE_INIT, start );
+	Stats_Memory( context, &Image, NULL );
 
-	//build the image for internal use
-	CML_image Image(1,1);
-	CML_image_ptr Image_Ptr(1,1);
-	Init_CML_Image(Source, S_Weights, &Image, &Image_Ptr);
+	//Work is Image, or TImage when removing horizontally
+	CML_image * Work = &Image;
+	bool edges_valid = false;
+	bool map_valid = false; //Work's energy map is the one the last seam came from
 
-	if( goal_x < (*Source).Width() )
+	for( int i = 0; i < max_attempts; i++ )
 	{
-		//reduce width
-		if( CAIR_Remove( &Image_Ptr, goal_x, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		int negative_x = 0;
+		int negative_y = 0;
+		Count_Negatives( &(*Work).weight, &negative_x, &negative_y );
+		if( Work == &TImage )
 		{
-			Shutdown_Threads();
-			return false;
+			std::swap( negative_x, negative_y );
 		}
-		seams_done += abs((*Source).Width()-goal_x);
-	}
 
-	if( goal_y < (*Source).Height() )
-	{
-		//reduce height
-		//works like above, except hand it a rotated image
-		CML_image_ptr TImage_Ptr(1,1);
-		TImage_Ptr.Transpose(&Image_Ptr);
+		//everything marked is gone
+		if( (negative_x == 0) && (negative_y == 0) )
+		{
+			break;
+		}
 
-		if( CAIR_Remove( &TImage_Ptr, goal_y, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		//remove in the direction that has the least to remove, unless told otherwise
+		bool horizontal = ( choice == HORIZONTAL ) || ( (choice == AUTO) && (negative_y < negative_x) );
+		int removes = horizontal ? negative_y : negative_x;
+		if( removes == 0 )
 		{
-			Shutdown_Threads();
-			return false;
+			break; //nothing left in the forced direction, and later attempts won't change that
 		}
-		
-		//store back the transposed info
-		Image_Ptr.Transpose(&TImage_Ptr);
-		seams_done += abs((*Source).Height()-goal_y);
-	}
 
-	if( goal_x > (*Source).Width() )
-	{
-		//increase width
-		if( CAIR_Add( &Image, &Image_Ptr, goal_x, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		//turn the image the right way for this direction
+		CML_image * Wanted = horizontal ? &TImage : &Image;
+		if( Work != Wanted )
 		{
-			Shutdown_Threads();
-			return false;
+			start = Stats_Start( context );
+			(*Wanted).Transpose( Work );
+			Stats_Stop( context, STAGE_TRANSPOSE, start );
+			Stats_Memory( context, &Image, &TImage );
+			Work = Wanted;
+			edges_valid = false;
+			map_valid = false;
 		}
-		seams_done += abs((*Source).Width()-goal_x);
-	}
 
-	if( goal_y > (*Source).Height() )
-	{
-		//increase height
-		//works like above, except hand it a rotated image
-		CML_image_ptr TImage_Ptr(1,1);
-		TImage_Ptr.Transpose(&Image_Ptr);
+		if( edges_valid == false )
+		{
+			Grayscale_Image( context, Work );
+			Edge_Detect( context, Work, conv );
+			edges_valid = true;
+		}
 
-		if( CAIR_Add( &Image, &TImage_Ptr, goal_y, conv, ener, CAIR_callback, total_seams, seams_done ) == false )
+		if( context->removal_band > 0 )
 		{
-			Shutdown_Threads();
-			return false;
+			//only look around the marked area, see CAIR_Removal_Band()
+			int left = 0;
+			int right = (*Work).Width() - 1;
+			Negative_Columns( &(*Work).weight, &left, &right );
+			if( Remove_Band_Seams( context, Work, (*Work).Width() - removes, left, right, context->removal_band, conv, ener, CAIR_callback, removes, 0 ) == false )
+			{
+				return false;
+			}
+			map_valid = false; //the band maps don't cover the whole image
+		}
+		else
+		{
+			if( Remove_Seams( context, Work, (*Work).Width() - removes, conv, ener, CAIR_callback, removes, 0, true, map_valid && (ener == BACKWARD) ) == false )
+			{
+				return false;
+			}
+			map_valid = true;
 		}
-		
-		//store back the transposed info
-		Image_Ptr.Transpose(&TImage_Ptr);
-		seams_done += abs((*Source).Height()-goal_y);
 	}
 
-	//pull the image data back out
-	Extract_CML_Image(&Image_Ptr, Dest, D_Weights);
+	//now expand back out to the origional
+	if( Work == &TImage )
+	{
+		start = Stats_Start( context );
+		Image.Transpose( &TImage );
+		Stats_Stop( context, STAGE_TRANSPOSE, start );
+	}
+	int total_seams = ((*Source).Width() - Image.Width()) + ((*Source).Height() - Image.Height());
+	if( Enlarge_Image( context, &Image, (*Source).Width(), (*Source).Height(), conv, ener, CAIR_callback, MAX(total_seams,1), 0 ) == false )
+	{
+		return false;
+	}
 
-	//shutdown threads, remove semaphores and mutexes
-	Shutdown_Threads();
+	start = Stats_Start( context );
+	Extract_CML_Image( &Image, Dest, D_Weights );
+	Stats_Stop( context, STAGE_EXTRACT, start );
 	return true;
-} //end CAIR()
+} //end CAIR_Removal()
 
 //=========================================================================================================//
-//==                                                E X T R A S                                          ==//
-//=========================================================================================================//
-//Simple function that generates the grayscale image of Source and places the result in Dest.
-void CAIR_Grayscale( CML_color * Source, CML_color * Dest )
+//Same as above, using the default context.
+bool CAIR_Removal( CML_color * Source, CML_int * S_Weights, CAIR_direction choice, int max_attempts, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
 {
-	Startup_Threads();
+	return CAIR_Removal( &default_context, Source, S_Weights, choice, max_attempts, conv, ener, D_Weights, Dest, CAIR_callback );
+}
 
-	CML_int weights((*Source).Width(),(*Source).Height()); //don't care about the values
-	CML_image image(1,1);
-	CML_image_ptr image_ptr(1,1);
+//=========================================================================================================//
+//==                                          I M A G E   M A P                                          ==//
+//=========================================================================================================//
 
-	Init_CML_Image(Source,&weights,&image,&image_ptr);
-	Grayscale_Image( &image_ptr );
+//=========================================================================================================//
+//Precompute the order every pixel gets removed in, down to CAIR_MAP_MIN pixels. V_Map gets the width the image had when
+//a vertical seam took out each pixel (0 for the ones that are never removed). If H_Map isn't NULL it gets the same thing for
+//horizontal seams, worked out separately on the full image. Pixel (x,y) is visible at any width of at least V_Map(x,y).
+bool CAIR_Image_Map( CAIR_Context * context, CML_color * Source, CML_int * Weights, CAIR_convolution conv, CAIR_energy ener, CML_int * V_Map, CML_int * H_Map, bool (*CAIR_callback)(float) )
+{
+	Startup_Threads( context );
 
-	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	int v_seams = MAX( (*Source).Width() - CAIR_MAP_MIN, 0 );
+	int h_seams = ( H_Map != NULL ) ? MAX( (*Source).Height() - CAIR_MAP_MIN, 0 ) : 0;
+	int total_seams = MAX( v_seams + h_seams, 1 );
 
-	for( int x = 0; x < (*Source).Width(); x++ )
+	//the removed plane is the map, so just remove everything there is to remove
+	CML_image Temp( 1, 1 );
+	Init_CML_Image( Source, Weights, &Temp );
+	Temp.Track_Removed();
+	if( CAIR_Remove( context, &Temp, (*Source).Width() - v_seams, conv, ener, CAIR_callback, total_seams, 0 ) == false )
 	{
-		for( int y = 0; y < (*Source).Height(); y++ )
+		return false;
+	}
+	(*V_Map) = Temp.removed;
+
+	if( H_Map != NULL )
+	{
+		CML_image Original( 1, 1 );
+		Init_CML_Image( Source, Weights, &Original );
+		Temp.Transpose( &Original );
+		Temp.Track_Removed();
+		if( CAIR_Remove( context, &Temp, (*Source).Height() - h_seams, conv, ener, CAIR_callback, total_seams, v_seams ) == false )
 		{
-			(*Dest)(x,y).red = image(x,y).gray;
-			(*Dest)(x,y).green = image(x,y).gray;
-			(*Dest)(x,y).blue = image(x,y).gray;
-			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+			return false;
 		}
+		(*H_Map).Transpose( &Temp.removed );
 	}
 
-	Shutdown_Threads();
-}
+	return true;
+} //end CAIR_Image_Map()
 
 //=========================================================================================================//
-//Simple function that generates the edge-detection image of Source and stores it in Dest.
-void CAIR_Edge( CML_color * Source, CAIR_convolution conv, CML_color * Dest )
+//Same as above, using the default context.
+bool CAIR_Image_Map( CML_color * Source, CML_int * Weights, CAIR_convolution conv, CAIR_energy ener, CML_int * V_Map, CML_int * H_Map, bool (*CAIR_callback)(float) )
 {
-	Startup_Threads();
+	return CAIR_Image_Map( &default_context, Source, Weights, conv, ener, V_Map, H_Map, CAIR_callback );
+}
 
-	CML_int weights((*Source).Width(),(*Source).Height()); //don't care about the values
-	CML_image image(1,1);
-	CML_image_ptr image_ptr(1,1);
+//=========================================================================================================//
+//Copy the pixels of row y that are visible at goal_x (map value of 0 or no more than goal_x) into Dest, a run at a time.
+//Returns how many were copied, which is never more than goal_x.
+inline int Map_Row( CML_RGBA * Source, int * Map, int width, int goal_x, CML_RGBA * Dest )
+{
+	int copied = 0;
+	int x = 0;
+	while( (x < width) && (copied < goal_x) )
+	{
+		//skip the pixels gone at this width
+		while( (x < width) && (Map[x] > goal_x) ) x++;
+
+		//then copy everything until the next one
+		int start = x;
+		while( (x < width) && (Map[x] <= goal_x) && (x - start < goal_x - copied) ) x++;
+		std::memcpy( &(Dest[copied]), &(Source[start]), (x - start) * sizeof(CML_RGBA) );
+		copied += x - start;
+	}
+	return copied;
+}
 
-	Init_CML_Image(Source,&weights,&image,&image_ptr);
-	Grayscale_Image(&image_ptr);
-	Edge_Detect( &image_ptr, conv );
+//=========================================================================================================//
+//Once the columns have been cut down, the V_Map values in a row come from different rows of the original, so a row can have
+//more or fewer than goal_x visible pixels. Keep the goal_x that go last instead, keeping the leftmost ones on ties.
+void Map_Row_Ranked( CML_RGBA * Source, int * Map, int width, int goal_x, CML_RGBA * Dest, int * Scratch )
+{
+	//find the goal_x'th smallest value; 0 (never removed) sorts first anyway
+	std::memcpy( Scratch, Map, width * sizeof(int) );
+	std::nth_element( Scratch, Scratch + goal_x - 1, Scratch + width );
+	int threshold = Scratch[goal_x - 1];
 
-	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	int ties = goal_x;
+	for( int x = 0; x < width; x++ )
+	{
+		if( Map[x] < threshold ) ties--;
+	}
 
-	for( int x = 0; x < (*Source).Width(); x++ )
+	int copied = 0;
+	for( int x = 0; x < width; x++ )
 	{
-		for( int y = 0; y < (*Source).Height(); y++ )
+		if( (Map[x] < threshold) || ((Map[x] == threshold) && (ties-- > 0)) )
 		{
-			int value = image(x,y).edge;
-
-			if( value > 255 )
-			{
-				value = 255;
-			}
-
-			(*Dest)(x,y).red = (CML_byte)value;
-			(*Dest)(x,y).green = (CML_byte)value;
-			(*Dest)(x,y).blue = (CML_byte)value;
-			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+			Dest[copied++] = Source[x];
 		}
 	}
-
-	Shutdown_Threads();
 }
 
 //=========================================================================================================//
-//Simple function that generates the vertical energy map of Source placing it into Dest.
-//All values are scaled down to their relative gray value. Weights are assumed all zero.
-void CAIR_V_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
+//Resize Source to goal_x by goal_y using maps from CAIR_Image_Map(), without any energy calculations. H_Map can be NULL if
+//the height isn't changing. The height goes first: each column keeps the pixels H_Map says are visible at goal_y, with their
+//V_Map values coming along, then each row is cut down to goal_x. Since the maps were made separately, resizing both ways
+//at once is only an approximation. Unlike CAIR(), removed pixels aren't averaged back into their neighbors.
+void CAIR_Map_Resize( CML_color * Source, CML_int * V_Map, CML_int * H_Map, int goal_x, int goal_y, CML_color * Dest )
 {
-	Startup_Threads();
-
-	CML_int weights((*Source).Width(),(*Source).Height());
-	weights.Fill(0);
-	CML_image image(1,1);
-	CML_image_ptr image_ptr(1,1);
-
-	Init_CML_Image(Source,&weights,&image,&image_ptr);
-	Grayscale_Image(&image_ptr);
-	Edge_Detect( &image_ptr, conv );
+	int width = (*Source).Width();
+	int height = (*Source).Height();
 
-	//calculate the energy map
-	Energy_Map( &image_ptr, ener, NULL );
+	//a map can't go below the pixels it never removed
+	goal_x = MIN( MAX( goal_x, MIN( CAIR_MAP_MIN, width ) ), width );
+	goal_y = ( H_Map != NULL ) ? MIN( MAX( goal_y, MIN( CAIR_MAP_MIN, height ) ), height ) : height;
 
-	int max_energy = 0; //find the maximum energy value
-	for( int y = 0; y < image.Height(); y++ )
+	CML_color Columns( 1, 1 );
+	CML_int Column_Map( 1, 1 );
+	if( goal_y < height )
 	{
-		for( int x = 0; x < image.Width(); x++ )
+		Columns.D_Resize( width, goal_y );
+		Column_Map.D_Resize( width, goal_y );
+
+		//go a row at a time, moving each visible pixel to the next free spot in its column
+		int * next = new int[width];
+		for( int x = 0; x < width; x++ )
 		{
-			if( image(x,y).energy > max_energy )
-			{
-				max_energy = image(x,y).energy;
-			}
+			next[x] = 0;
 		}
-	}
-	
-	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
-
-	for( int y = 0; y < image.Height(); y++ )
-	{
-		for( int x = 0; x < image.Width(); x++ )
+		for( int y = 0; y < height; y++ )
 		{
-			//scale the gray value down so we can get a realtive gray value for the energy level
-			int value = (int)(((double)image(x,y).energy / max_energy) * 255);
-			if( value < 0 )
+			for( int x = 0; x < width; x++ )
 			{
-				value = 0;
+				if( ((*H_Map)(x,y) <= goal_y) && (next[x] < goal_y) )
+				{
+					Columns(x,next[x]) = (*Source)(x,y);
+					Column_Map(x,next[x]) = (*V_Map)(x,y);
+					next[x]++;
+				}
 			}
+		}
+		delete[] next;
 
-			(*Dest)(x,y).red = (CML_byte)value;
-			(*Dest)(x,y).green = (CML_byte)value;
-			(*Dest)(x,y).blue = (CML_byte)value;
-			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+		(*Dest).D_Resize( goal_x, goal_y );
+		int * scratch = new int[width];
+		for( int y = 0; y < goal_y; y++ )
+		{
+			Map_Row_Ranked( Columns.Row( y ), Column_Map.Row( y ), width, goal_x, (*Dest).Row( y ), scratch );
 		}
+		delete[] scratch;
+		return;
 	}
 
-	Shutdown_Threads();
-} //end CAIR_V_Energy()
+	(*Dest).D_Resize( goal_x, goal_y );
+	for( int y = 0; y < goal_y; y++ )
+	{
+		Map_Row( (*Source).Row( y ), (*V_Map).Row( y ), width, goal_x, (*Dest).Row( y ) );
+	}
+} //end CAIR_Map_Resize()
 
 //=========================================================================================================//
-//Simple function that generates the horizontal energy map of Source placing it into Dest.
-//All values are scaled down to their relative gray value. Weights are assumed all zero.
-void CAIR_H_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest )
-{
-	CML_color Tsource( 1, 1 );
-	CML_color Tdest( 1, 1 );
+//Map files are little-endian, no matter the machine: an 8 byte magic, then the CAIR_Map_Info fields as 32 bit values (the
+//hash as 64 bits), then the bits used for each map value, then V_Map and H_Map (if there is one) a row at a time.
+static const char CAIR_MAP_MAGIC[8] = { 'C', 'A', 'I', 'R', 'M', 'A', 'P', 0 };
 
-	Tsource.Transpose( Source );
-	CAIR_V_Energy( &Tsource, conv, ener, &Tdest );
+inline bool Write_Value( FILE * file, unsigned long long value, int bytes )
+{
+	unsigned char buffer[8];
+	for( int i = 0; i < bytes; i++ )
+	{
+		buffer[i] = (unsigned char)( value >> (8*i) );
+	}
+	return fwrite( buffer, 1, bytes, file ) == (size_t)bytes;
+}
 
-	(*Dest).Transpose( &Tdest );
+inline bool Read_Value( FILE * file, unsigned long long * value, int bytes )
+{
+	unsigned char buffer[8];
+	if( fread( buffer, 1, bytes, file ) != (size_t)bytes )
+	{
+		return false;
+	}
+	(*value) = 0;
+	for( int i = 0; i < bytes; i++ )
+	{
+		(*value) |= (unsigned long long)buffer[i] << (8*i);
+	}
+	return true;
 }
 
 //=========================================================================================================//
-//Experimental automatic object removal.
-//Any area with a negative weight will be removed. This function has three modes, determined by the choice paramater.
-//AUTO will have the function count the veritcal and horizontal rows/columns and remove in the direction that has the least.
-//VERTICAL will force the function to remove all negative weights in the veritcal direction; likewise for HORIZONTAL.
-//Because some conditions may cause the function not to remove all negative weights in one pass, max_attempts lets the function
-//go through the remoal process as many times as you're willing.
-bool CAIR_Removal( CML_color * Source, CML_int * S_Weights, CAIR_direction choice, int max_attempts, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+//Write a map a row at a time, each value in value_bytes bytes.
+bool Write_Map( FILE * file, CML_int * Map, int value_bytes )
 {
-	int negative_x = 0;
-	int negative_y = 0;
-	CML_color Temp( 1, 1 );
-	Temp = (*Source);
-	(*D_Weights) = (*S_Weights);
+	int width = (*Map).Width();
+	unsigned char * buffer = new unsigned char[width * value_bytes];
+	bool ok = true;
 
-	for( int i = 0; i < max_attempts; i++ )
+	for( int y = 0; (y < (*Map).Height()) && ok; y++ )
 	{
-		negative_x = 0;
-		negative_y = 0;
-
-		//count how many negative columns exist
-		for( int x = 0; x < (*D_Weights).Width(); x++ )
+		int * row = (*Map).Row( y );
+		for( int x = 0; x < width; x++ )
 		{
-			for( int y = 0; y < (*D_Weights).Height(); y++ )
+			for( int i = 0; i < value_bytes; i++ )
 			{
-				if( (*D_Weights)(x,y) < 0 )
-				{
-					negative_x++;
-					break; //only breaks the inner loop
-				}
+				buffer[x*value_bytes + i] = (unsigned char)( row[x] >> (8*i) );
 			}
 		}
+		ok = ( fwrite( buffer, value_bytes, width, file ) == (size_t)width );
+	}
 
-		//count how many negative rows exist
-		for( int y = 0; y < (*D_Weights).Height(); y++ )
-		{
-			for( int x = 0; x < (*D_Weights).Width(); x++ )
-			{
-				if( (*D_Weights)(x,y) < 0 )
-				{
-					negative_y++;
-					break;
-				}
-			}
-		}
+	delete[] buffer;
+	return ok;
+}
 
-		switch( choice )
-		{
-		case AUTO :
-			//remove in the direction that has the least to remove
-			if( negative_y < negative_x )
-			{
-				if( CAIR( &Temp, D_Weights, Temp.Width(), Temp.Height() - negative_y, conv, ener, D_Weights, Dest, CAIR_callback ) == false )
-				{
-					return false;
-				}
-				Temp = (*Dest);
-			}
-			else
-			{
-				if( CAIR( &Temp, D_Weights, Temp.Width() - negative_x, Temp.Height(), conv, ener, D_Weights, Dest, CAIR_callback ) == false )
-				{
-					return false;
-				}
-				Temp = (*Dest);
-			}
-			break;
+//=========================================================================================================//
+//Read a map written by Write_Map() into Map, which must already be the right size.
+bool Read_Map( FILE * file, CML_int * Map, int value_bytes )
+{
+	int width = (*Map).Width();
+	unsigned char * buffer = new unsigned char[width * value_bytes];
+	bool ok = true;
 
-		case HORIZONTAL :
-			if( CAIR( &Temp, D_Weights, Temp.Width(), Temp.Height() - negative_y, conv, ener, D_Weights, Dest, CAIR_callback ) == false )
-			{
-				return false;
-			}
-			Temp = (*Dest);
-			break;
+	for( int y = 0; (y < (*Map).Height()) && ok; y++ )
+	{
+		ok = ( fread( buffer, value_bytes, width, file ) == (size_t)width );
 
-		case VERTICAL :
-			if( CAIR( &Temp, D_Weights, Temp.Width() - negative_x, Temp.Height(), conv, ener, D_Weights, Dest, CAIR_callback ) == false )
+		int * row = (*Map).Row( y );
+		for( int x = 0; (x < width) && ok; x++ )
+		{
+			//unsigned, since the top byte of a 32 bit value would shift into the sign bit
+			unsigned int value = 0;
+			for( int i = 0; i < value_bytes; i++ )
 			{
-				return false;
+				value |= (unsigned int)buffer[x*value_bytes + i] << (8*i);
 			}
-			Temp = (*Dest);
-			break;
+			row[x] = (int)value;
 		}
 	}
 
-	//now expand back out to the origional
-	return CAIR( &Temp, D_Weights, (*Source).Width(), (*Source).Height(), conv, ener, D_Weights, Dest, CAIR_callback );
-} //end CAIR_Removal()
+	delete[] buffer;
+	return ok;
+}
 
-//The following Image Map functions are deprecated until better alternatives can be made.
-#if 0
 //=========================================================================================================//
-//Precompute removals in the x direction. Map will hold the largest width the corisponding pixel is still visible.
-//This will calculate all removals down to 3 pixels in width.
-//Right now this only performs removals and only the x-direction. For the future enlarging is planned. Precomputing for both directions
-//doesn't work all that well and generates significant artifacts. This function is intended for "content-aware multi-size images" as mentioned
-//in the doctors' presentation. The next logical step would be to encode Map into an existing image format. Then, using a function like
-//CAIR_Map_Resize() the image can be resized on a client machine with very little overhead.
-void CAIR_Image_Map( CML_color * Source, CML_int * Weights, CAIR_convolution conv, CAIR_energy ener, CML_int * Map )
+//64 bit FNV-1a hash of the color channels, to tie a map file to the image it was made from.
+unsigned long long CAIR_Image_Hash( CML_color * Source )
 {
-	Startup_Threads();
-	Resize_Threads( (*Source).Height() );
-
-	(*Map).D_Resize( (*Source).Width(), (*Source).Height() );
-	(*Map).Fill( 0 );
-
-	CML_color Temp( 1, 1 );
-	Temp = (*Source);
-	CML_int Temp_Weights( 1, 1 );
-	Temp_Weights = (*Weights); //don't change Weights since there is no change to the image
-
-	for( int i = Temp.Width(); i > 3; i-- ) //3 is the minimum safe amount with 3x3 convolution kernels without causing problems
+	unsigned long long hash = 14695981039346656037ULL;
+	for( int y = 0; y < (*Source).Height(); y++ )
 	{
-		//grayscale
-		CML_gray Grayscale( Temp.Width(), Temp.Height() );
-		Grayscale_Image( &Temp, &Grayscale );
+		CML_RGBA * row = (*Source).Row( y );
+		for( int x = 0; x < (*Source).Width(); x++ )
+		{
+			hash = ( hash ^ row[x].red ) * 1099511628211ULL;
+			hash = ( hash ^ row[x].green ) * 1099511628211ULL;
+			hash = ( hash ^ row[x].blue ) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
 
-		//edge detect
-		CML_int Edge( Temp.Width(), Temp.Height() );
-		Edge_Detect( &Grayscale, &Edge, conv );
+//=========================================================================================================//
+//Save the maps from CAIR_Image_Map() for Source to filename. H_Map can be NULL.
+bool CAIR_Save_Map( const char * filename, CML_color * Source, CML_int * V_Map, CML_int * H_Map, CAIR_convolution conv, CAIR_energy ener )
+{
+	int width = (*V_Map).Width();
+	int height = (*V_Map).Height();
+	if( (width != (*Source).Width()) || (height != (*Source).Height()) ||
+		((H_Map != NULL) && (((*H_Map).Width() != width) || ((*H_Map).Height() != height))) )
+	{
+		return false;
+	}
 
-		//find the energy values
-		int * Path = new int[(*Source).Height()];
-		CML_int Energy( Temp.Width(), Temp.Height() );
-		Energy_Path( &Edge, &Temp_Weights, &Energy, Path, ener, true );
+	FILE * file = fopen( filename, "wb" );
+	if( file == NULL )
+	{
+		return false;
+	}
 
-		Remove_Path( &Temp, Path, &Temp_Weights, &Edge, &Grayscale, &Energy, conv );
+	//the values are widths and heights, so they nearly always fit in 16 bits
+	int value_bytes = ( MAX( width, height ) < 65536 ) ? 2 : 4;
 
-		//now set the corisponding map value with the resolution
-		for( int y = 0; y < Temp.Height(); y++ )
-		{
-			int index = 0;
-			int offset = Path[y];
+	bool ok = ( fwrite( CAIR_MAP_MAGIC, 1, 8, file ) == 8 )
+		&& Write_Value( file, CAIR_MAP_VERSION, 4 )
+		&& Write_Value( file, width, 4 )
+		&& Write_Value( file, height, 4 )
+		&& Write_Value( file, conv, 4 )
+		&& Write_Value( file, ener, 4 )
+		&& Write_Value( file, ( H_Map != NULL ) ? 1 : 0, 4 )
+		&& Write_Value( file, CAIR_Image_Hash( Source ), 8 )
+		&& Write_Value( file, value_bytes * 8, 4 )
+		&& Write_Map( file, V_Map, value_bytes )
+		&& ( ( H_Map == NULL ) || Write_Map( file, H_Map, value_bytes ) );
 
-			while( (*Map)(index,y) != 0 ) index++; //find the pixel that is in location zero (first unused)
-			while( offset > 0 )
-			{
-				if( (*Map)(index,y) == 0 ) //find the correct x index
-				{
-					offset--;
-				}
-				index++;
-			}
-			while( (*Map)(index,y) != 0 ) index++; //if the current and subsequent pixels have been removed
+	return ( fclose( file ) == 0 ) && ok;
+} //end CAIR_Save_Map()
 
-			(*Map)(index,y) = i; //this is now the smallest resolution this pixel will be visible
-		}
+//=========================================================================================================//
+//64 bit file positions, since ftell() and fseek() go through long, which is 32 bits on Windows and 32 bit builds.
+//(32 bit Linux builds also need _FILE_OFFSET_BITS=64 for fopen() to open files that big in the first place.)
+#ifdef _WIN32
+#define CAIR_FTELL _ftelli64
+#define CAIR_FSEEK _fseeki64
+#else
+#define CAIR_FTELL ftello
+#define CAIR_FSEEK fseeko
+#endif
 
-		delete[] Path;
+//How many bytes are left in file after the current position, or -1 if that can't be told.
+long long Bytes_Left( FILE * file )
+{
+	long long here = CAIR_FTELL( file );
+	if( (here < 0) || (CAIR_FSEEK( file, 0, SEEK_END ) != 0) )
+	{
+		return -1;
 	}
-
-	Shutdown_Threads();
-
-} //end CAIR_Image_Map()
+	long long end = CAIR_FTELL( file );
+	if( (end < here) || (CAIR_FSEEK( file, here, SEEK_SET ) != 0) )
+	{
+		return -1;
+	}
+	return end - here;
+}
 
 //=========================================================================================================//
-//An "example" function on how to decode the Map to quickly resize an image. This is only for the width, since multi-directional
-//resizing produces significant artifacts. Do note this will produce different results than standard CAIR(), because this resize doesn't
-//average pixels back into the image as does CAIR(). This function could be multi-threaded much like Remove_Path() for even faster performance.
-void CAIR_Map_Resize( CML_color * Source, CML_int * Map, int goal_x, CML_color * Dest )
+//Load maps saved by CAIR_Save_Map(). See the header for the details.
+bool CAIR_Load_Map( const char * filename, CML_color * Source, CML_int * V_Map, CML_int * H_Map, CAIR_Map_Info * Info )
 {
-	(*Dest).D_Resize( goal_x, (*Source).Height() );
+	FILE * file = fopen( filename, "rb" );
+	if( file == NULL )
+	{
+		return false;
+	}
 
-	for( int y = 0; y < (*Source).Height(); y++ )
+	char magic[8];
+	unsigned long long version = 0, width = 0, height = 0, conv = 0, ener = 0, has_h_map = 0, hash = 0, value_bits = 0;
+	bool ok = ( fread( magic, 1, 8, file ) == 8 ) && ( std::memcmp( magic, CAIR_MAP_MAGIC, 8 ) == 0 )
+		&& Read_Value( file, &version, 4 ) && ( version == CAIR_MAP_VERSION )
+		&& Read_Value( file, &width, 4 ) && Read_Value( file, &height, 4 )
+		&& Read_Value( file, &conv, 4 ) && Read_Value( file, &ener, 4 )
+		&& Read_Value( file, &has_h_map, 4 ) && Read_Value( file, &hash, 8 )
+		&& Read_Value( file, &value_bits, 4 ) && ( (value_bits == 16) || (value_bits == 32) )
+		&& ( width > 0 ) && ( height > 0 ) && ( width <= 1 << 24 ) && ( height <= 1 << 24 )
+		&& ( conv <= LAPLACIAN ) && ( ener <= FORWARD );
+
+	//don't trust the size until the file backs it up, a bad header shouldn't get to allocate anything
+	if( ok )
 	{
-		int input_x = 0; //map the Source's pixels to the Dests smaller size
-		for( int x = 0; x < goal_x; x++ )
-		{
-			while( (*Map)(input_x,y) > goal_x ) input_x++; //skip past pixels not in this resolution
+		unsigned long long cells = width * height;
+		unsigned long long needed = cells * (value_bits / 8) * ( (has_h_map != 0) ? 2 : 1 );
+		long long left = Bytes_Left( file );
+		ok = ( cells <= (unsigned long long)std::numeric_limits<int>::max() ) && ( left >= 0 ) && ( needed <= (unsigned long long)left );
+	}
+
+	//a map is only good for the image it was made from
+	if( ok && (Source != NULL) )
+	{
+		ok = ( (int)width == (*Source).Width() ) && ( (int)height == (*Source).Height() ) && ( hash == CAIR_Image_Hash( Source ) );
+	}
 
-			(*Dest)(x,y) = (*Source)(input_x,y);
-			input_x++;
+	if( ok )
+	{
+		(*V_Map).D_Resize( (int)width, (int)height );
+		ok = Read_Map( file, V_Map, (int)value_bits / 8 );
+	}
+	if( ok && (H_Map != NULL) )
+	{
+		if( has_h_map != 0 )
+		{
+			(*H_Map).D_Resize( (int)width, (int)height );
+			ok = Read_Map( file, H_Map, (int)value_bits / 8 );
+		}
+		else
+		{
+			//nothing left over from an earlier map
+			(*H_Map).D_Resize( 1, 1 );
+			(*H_Map).Fill( 0 );
 		}
 	}
-}
-#endif
+	fclose( file );
+
+	if( ok && (Info != NULL) )
+	{
+		(*Info).version = (int)version;
+		(*Info).width = (int)width;
+		(*Info).height = (int)height;
+		(*Info).conv = (CAIR_convolution)conv;
+		(*Info).ener = (CAIR_energy)ener;
+		(*Info).has_h_map = ( has_h_map != 0 );
+		(*Info).source_hash = hash;
+	}
+	return ok;
+} //end CAIR_Load_Map()
 
 //=========================================================================================================//
 //==                                             C A I R  H D                                            ==//
@@ -1710,10 +4039,8 @@ void CAIR_Map_Resize( CML_color * Source, CML_int * Map, int goal_x, CML_color *
 //will determine which direction has the least amount of energy and then removes in that direction. This is only done
 //for removal, since enlarging will not benifit, although this function will perform addition just like CAIR().
 //Inputs are the same as CAIR().
-bool CAIR_HD( CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+bool CAIR_HD( CAIR_Context * context, CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
 {
-	Startup_Threads();
-
 	//if no change, then just copy to the source to the destination
 	if( (goal_x == (*Source).Width()) && (goal_y == (*Source).Height()) )
 	{
@@ -1722,62 +4049,82 @@ bool CAIR_HD( CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, C
 		return true;
 	}
 
+	Startup_Threads( context );
+
 	int total_seams = abs((*Source).Width()-goal_x) + abs((*Source).Height()-goal_y);
 	int seams_done = 0;
 
 	//build the internal image
-	//I only use one image, but two image pointers. This way I can reuse the data.
+	//Both directions work on this one image, so there is nothing to transpose between seams.
+	double start = Stats_Start( context );
 	CML_image Temp(1,1);
-	CML_image_ptr Temp_ptr(1,1);
-	CML_image_ptr TTemp_ptr(1,1);
-	Init_CML_Image( Source, S_Weights, &Temp, &Temp_ptr );
-	TTemp_ptr.Transpose(&Temp_ptr);
+	Init_CML_Image( Source, S_Weights, &Temp );
+	Stats_Stop( context, STAGE_INIT, start );
+
+	//grayscale (same for both directions)
+	Grayscale_Image( context, &Temp );
 
-	//grayscale (same for normal and transposed)
-	Grayscale_Image( &Temp_ptr );
+	//edge detect (same for both directions)
+	Edge_Detect( context, &Temp, conv );
 
-	//edge detect (same for normal and transposed)
-	Edge_Detect( &Temp_ptr, conv );
+	//Both energy maps are kept from seam to seam. After a removal the map in the same direction is only updated around the
+	//seam, with the exact version of the update (see Energy_Map()), while the other one recalculates from the first row (or
+	//column) the seam touched. Either way they come out the same as full maps, so the seams are too.
+	Temp.Track_H_Energy();
+	int * Path = Scratch_Path( context, 0, Temp.Height() );
+	int * TPath = Scratch_Path( context, 1, Temp.Width() );
+	Stats_Memory( context, &Temp, NULL );
+	int energy_x = Energy_Path( context, &Temp, Path, ener, true );
+	int energy_y = Energy_H_Path( context, &Temp, TPath, ener, false, 0 );
 
 	//do this loop when we can remove in either direction
-	while( (Temp_ptr.Width() > goal_x) && (Temp_ptr.Height() > goal_y) )
+	while( (Temp.Width() > goal_x) && (Temp.Height() > goal_y) )
 	{
-		//find the least energy seam, and its total energy for the normal image
-		int * Path = new int[Temp_ptr.Height()];
-		int energy_x = Energy_Path( &Temp_ptr, Path, ener, true );
-
-		//now rebuild the energy, with the transposed pointers
-		int * TPath = new int[TTemp_ptr.Height()];
-		int energy_y = Energy_Path( &TTemp_ptr, TPath, ener, true );
-
 		if( energy_y < energy_x )
 		{
-			Remove_Path( &TTemp_ptr, TPath, conv );
+			Remove_H_Path( context, &Temp, TPath, conv );
+			int top_y = MAX( *std::min_element( TPath, TPath + Temp.Width() ) - 3, 0 );
 
-			//rebuild the losers pointers
-			Temp_ptr.Transpose( &TTemp_ptr );
+			energy_y = Energy_H_Path( context, &Temp, TPath, ener, true, 0 );
+			Energy_Map_Rows( context, &Temp, ener, top_y );
+
+			double start = Stats_Start( context );
+			energy_x = Least_Path( &Temp.energy, Path );
+			Stats_Stop( context, STAGE_PATH, start );
 		}
 		else
 		{
-			Remove_Path( &Temp_ptr, Path, conv );
+			Remove_Path( context, &Temp, Path, conv );
+			int top_x = MAX( *std::min_element( Path, Path + Temp.Height() ) - 3, 0 );
 
-			//rebuild the losers pointers
-			TTemp_ptr.Transpose( &Temp_ptr );
-		}
+			Energy_Map( context, &Temp, ener, Path, true );
+			energy_y = Energy_H_Path( context, &Temp, TPath, ener, false, top_x );
 
-		delete[] Path;
-		delete[] TPath;
+			double start = Stats_Start( context );
+			energy_x = Least_Path( &Temp.energy, Path );
+			Stats_Stop( context, STAGE_PATH, start );
+		}
 
 		if( (CAIR_callback != NULL) && (CAIR_callback( (float)(seams_done)/total_seams ) == false) )
 		{
-			Shutdown_Threads();
 			return false;
 		}
 		seams_done++;
 	}
 
 	//one dimension is the now on the goal, so finish off the other direction
-	Extract_CML_Image(&Temp_ptr, Dest, D_Weights); //we should be able to get away with using the Dest as the Source
-	Shutdown_Threads();
-	return CAIR( Dest, D_Weights, goal_x, goal_y, conv, ener, D_Weights, Dest, CAIR_callback );
+	//go through a temporary rather than Dest, which may be Attach()'ed memory only big enough for the result. Passing the
+	//bigger image through it would move Dest into memory of its own, and the result would not end up where the caller wanted.
+	start = Stats_Start( context );
+	CML_color Rest( 1, 1 );
+	Extract_CML_Image(&Temp, &Rest, D_Weights);
+	Stats_Stop( context, STAGE_EXTRACT, start );
+	return CAIR( context, &Rest, D_Weights, goal_x, goal_y, conv, ener, D_Weights, Dest, CAIR_callback );
 } //end CAIR_HD()
+
+//=========================================================================================================//
+//Same as above, using the default context.
+bool CAIR_HD( CML_color * Source, CML_int * S_Weights, int goal_x, int goal_y, CAIR_convolution conv, CAIR_energy ener, CML_int * D_Weights, CML_color * Dest, bool (*CAIR_callback)(float) )
+{
+	return CAIR_HD( &default_context, Source, S_Weights, goal_x, goal_y, conv, ener, D_Weights, Dest, CAIR_callback );
+}
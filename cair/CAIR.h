@@ -26,14 +26,109 @@
 
 //=========================================================================================================//
 //The default number of threads that will be used for Grayscale, Edge, and Add/Remove operations.
-//Minimum of 2 required.
+//Minimum of 1 required.
 #define CAIR_NUM_THREADS 4
 
+//Full energy maps of images with at least this many pixels are split across the threads, in blocks of CAIR_ENERGY_BLOCK rows.
+#define CAIR_PARALLEL_ENERGY (1024*1024)
+#define CAIR_ENERGY_BLOCK 32
+
+//Images with fewer pixels than this have their seams removed on the calling thread. For those, waking the threads up and
+//waiting on them takes longer than the removal itself.
+#define CAIR_SERIAL_REMOVE (256*256)
+
+//Luma weights for the grayscale, in thousandths; they must add up to 1000. The default is BT.601. Define CAIR_LUMA_BT709
+//when building for BT.709 weights instead, or define all three to use your own.
+#ifndef CAIR_LUMA_R
+#ifdef CAIR_LUMA_BT709
+#define CAIR_LUMA_R 213
+#define CAIR_LUMA_G 715
+#define CAIR_LUMA_B 72
+#else
+#define CAIR_LUMA_R 299
+#define CAIR_LUMA_G 587
+#define CAIR_LUMA_B 114
+#endif
+#endif
+
 //=========================================================================================================//
-//Set the number of threads that CAIR should use. Minimum of 2 required.
+//A CAIR_Context holds the threads, semaphores, and scratch memory used during a resize.
+//Every function below has a version that takes a context as its first parameter. Separate contexts can be used
+//from separate threads at the same time. The versions without a context all share a single default context,
+//so only one of those may be running at a time.
+struct CAIR_Context;
+
+//Create a context that will use thread_count threads. Minimum of 1 required.
+CAIR_Context * CAIR_Create_Context( int thread_count );
+
+//Destroy a context made by CAIR_Create_Context(). Never destroy a context that is still processing an image.
+void CAIR_Destroy_Context( CAIR_Context * context );
+
+//=========================================================================================================//
+//Set the number of threads that CAIR should use. Minimum of 1 required.
 //WARNING: Never call this function while CAIR() is processing an image, otherwise bad things will happen!
 //Best to set this only once, before any CAIR operations take place.
 void CAIR_Threads( int thread_count );
+void CAIR_Threads( CAIR_Context * context, int thread_count );
+
+//=========================================================================================================//
+//Set how many seams are removed for each energy map that is built. The default of 1 removes the best seam, updates the map,
+//and repeats, for the best quality. Larger values take that many non-overlapping seams from a single map and remove them all
+//in one pass, which is much faster for large reductions at some cost in quality (CAIR_PSNR() can measure the difference).
+//CAIR_ADAPTIVE_SEAMS takes 1/32 of the current width each pass. This affects CAIR() and the seams it picks for enlarging;
+//CAIR_HD() and CAIR_Removal() always take one seam at a time.
+//While tracing, a pixel already taken by another seam (or off the edge) counts as energy INT_MAX. A seam with only those to
+//step to is boxed in, and is dropped, so a pass can take fewer seams than asked for (always at least one). This also means a
+//pixel whose energy reaches INT_MAX is never used, so keep weights within the range suggested for CAIR().
+#define CAIR_ADAPTIVE_SEAMS 0
+void CAIR_Seams( int seams );
+void CAIR_Seams( CAIR_Context * context, int seams );
+
+//=========================================================================================================//
+//Lets CAIR_Removal() search for its seams only in a band of columns (or rows) around the area marked for removal, reaching
+//margin pixels past it on each side. The band is widened whenever the best seam in it runs along one of its edges, so the
+//seams are only the best ones within the band, but the cost of each no longer grows with the image. The default of 0 searches
+//the whole image every time. Worth it for narrow objects in wide images. It helps the most when the object runs most of the
+//way down the image, since above and below it the seams are free to wander off toward the band's edges.
+void CAIR_Removal_Band( int margin );
+void CAIR_Removal_Band( CAIR_Context * context, int margin );
+
+//=========================================================================================================//
+//Which SIMD kernels the stages run. The first time CAIR needs to know, it picks the best the CPU has, or less if the CAIR_SIMD
+//environment variable names a lower one ("scalar", "sse2", "avx2" or "avx512"). CAIR_Set_SIMD() can change it afterwards, for
+//example to compare against the scalar code. Asking for more than the CPU has gets the best it does have.
+//All of them give exactly the same results. This is for the whole program, not a context. It is safe to call from any thread,
+//even while other contexts are processing images: they just carry on with the new kernels, and get the same results.
+enum CAIR_simd { CAIR_SCALAR = 0, CAIR_SIMD_SSE2 = 1, CAIR_SIMD_AVX2 = 2, CAIR_SIMD_AVX512 = 3 };
+void CAIR_Set_SIMD( CAIR_simd level );
+CAIR_simd CAIR_Get_SIMD();
+const char * CAIR_SIMD_Name( CAIR_simd level );
+
+//=========================================================================================================//
+//Runtime statistics, for finding out where the time goes without a profiler. Once a CAIR_Stats is handed to CAIR_Collect_Stats(),
+//CAIR(), CAIR_HD() and CAIR_Removal() on that context add to it until CAIR_Collect_Stats() is called again (NULL turns it off).
+//seconds[] is the wall time of each stage. Edge recalculation after a seam counts as STAGE_REMOVE, and STAGE_PATH is
+//finding the seams in a finished energy map. energy_cells is how many energy map entries were calculated, and energy_cells_full
+//how many there would have been if every map was calculated in full.
+//syncs counts the times the worker threads were started and waited on. sync_seconds is the part of those that went beyond the
+//slowest thread's work (waking threads up and waiting on semaphores), and imbalance_seconds is how much longer the slowest thread
+//took than the average one. Both overlap the stage times.
+//peak_bytes is the most memory held at once by the internal images and scratch buffers.
+//Collecting stats costs a few clock reads per stage. Don't share a CAIR_Stats between contexts that run at the same time.
+enum CAIR_stage { STAGE_INIT = 0, STAGE_GRAYSCALE, STAGE_EDGE, STAGE_ENERGY, STAGE_PATH, STAGE_REMOVE, STAGE_ADD, STAGE_TRANSPOSE, STAGE_EXTRACT, CAIR_STAGES };
+struct CAIR_Stats
+{
+	double seconds[CAIR_STAGES];
+	long long seams;
+	long long energy_cells;
+	long long energy_cells_full;
+	long long syncs;
+	double sync_seconds;
+	double imbalance_seconds;
+	size_t peak_bytes;
+};
+void CAIR_Collect_Stats( CAIR_Stats * stats );
+void CAIR_Collect_Stats( CAIR_Context * context, CAIR_Stats * stats );
 
 //=========================================================================================================//
 //The Great CAIR Frontend. This baby will retarget Source using S_Weights into the dimensions supplied by goal_x and goal_y into D_Weights and Dest.
@@ -62,24 +157,44 @@ bool CAIR( CML_color * Source,
            CML_int * D_Weights,
            CML_color * Dest,
            bool (*CAIR_callback)(float) );
+bool CAIR( CAIR_Context * context,
+           CML_color * Source,
+           CML_int * S_Weights,
+           int goal_x,
+           int goal_y,
+           CAIR_convolution conv,
+           CAIR_energy ener,
+           CML_int * D_Weights,
+           CML_color * Dest,
+           bool (*CAIR_callback)(float) );
 
 //=========================================================================================================//
 //Simple function that generates the grayscale image of Source and places the result in Dest.
 void CAIR_Grayscale( CML_color * Source, CML_color * Dest );
+void CAIR_Grayscale( CAIR_Context * context, CML_color * Source, CML_color * Dest );
 
 //=========================================================================================================//
 //Simple function that generates the edge-detection image of Source and stores it in Dest.
 void CAIR_Edge( CML_color * Source, CAIR_convolution conv, CML_color * Dest );
+void CAIR_Edge( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CML_color * Dest );
 
 //=========================================================================================================//
 //Simple function that generates the vertical energy map of Source placing it into Dest.
 //All values are scaled down to their relative gray value. Weights are assumed all zero.
 void CAIR_V_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest );
+void CAIR_V_Energy( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest );
 
 //=========================================================================================================//
 //Simple function that generates the horizontal energy map of Source placing it into Dest.
 //All values are scaled down to their relative gray value. Weights are assumed all zero.
 void CAIR_H_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest );
+void CAIR_H_Energy( CAIR_Context * context, CML_color * Source, CAIR_convolution conv, CAIR_energy ener, CML_color * Dest );
+
+//=========================================================================================================//
+//Returns the peak signal-to-noise ratio, in dB, between the color channels of two images of the same size. Higher is closer.
+//Meant for measuring how far a faster setting (like CAIR_Seams()) drifts from the default output. Identical images give infinity,
+//and images of different sizes give 0.
+double CAIR_PSNR( CML_color * First, CML_color * Second );
 
 //=========================================================================================================//
 //Experimental
@@ -87,7 +202,7 @@ void CAIR_H_Energy( CML_color * Source, CAIR_convolution conv, CAIR_energy ener,
 //AUTO will have the function count the vertical and horizontal rows/columns and remove in the direction that has the least.
 //VERTICAL will force the function to remove all negative weights in the vertical direction; likewise for HORIZONTAL.
 //Because some conditions may cause the function not to remove all negative weights in one pass, max_attempts lets the function
-//go through the removal process as many times as you're willing.
+//go through the removal process as many times as you're willing. It stops early once no negative weights are left.
 enum CAIR_direction { AUTO = 0, VERTICAL = 1, HORIZONTAL = 2 };
 bool CAIR_Removal( CML_color * Source,
                    CML_int * S_Weights,
@@ -98,26 +213,74 @@ bool CAIR_Removal( CML_color * Source,
                    CML_int * D_Weights,
                    CML_color * Dest,
                    bool (*CAIR_callback)(float) );
+bool CAIR_Removal( CAIR_Context * context,
+                   CML_color * Source,
+                   CML_int * S_Weights,
+                   CAIR_direction choice,
+                   int max_attempts,
+                   CAIR_convolution conv,
+                   CAIR_energy ener,
+                   CML_int * D_Weights,
+                   CML_color * Dest,
+                   bool (*CAIR_callback)(float) );
 
-//The following Image Map functions are deprecated until better alternatives can be made.
-#if 0
 //=========================================================================================================//
-//Experimental
-//Precompute removals in the x direction. Map will hold the largest width the corresponding pixel is still visible.
-//This will calculate all removals down to 3 pixels in width.
-//Right now this only performs removals and only the x-direction. For the future enlarging is planned. Precomputing for both directions
-//doesn't work all that well and generates significant artifacts. This function is intended for "content-aware multi-size images" as mentioned
-//in the doctor's presentation. The next logical step would be to encode Map into an existing image format. Then, using a function like
-//CAIR_Map_Resize() the image can be resized on a client machine with very little overhead.
-void CAIR_Image_Map( CML_color * Source, CML_int * Weights, CAIR_convolution conv, CAIR_energy ener, CML_int * Map );
+//Content-aware multi-size images, as mentioned in the doctors' presentation. CAIR_Image_Map() works out, once, the order every
+//pixel would be removed in, and CAIR_Map_Resize() can then produce any smaller size from that with no energy calculations, at
+//about the speed of a copy. Handy when the same image is needed at many sizes.
+//V_Map gets, for every pixel, the width the image had when a vertical seam removed it (0 if it never was). Removal stops at
+//CAIR_MAP_MIN pixels wide. If H_Map isn't NULL it gets the same for horizontal seams, computed separately on the full image.
+//CAIR_Seams() is honored, so large images can be mapped quickly at some cost in quality.
+#define CAIR_MAP_MIN 3
+bool CAIR_Image_Map( CML_color * Source,
+                     CML_int * Weights,
+                     CAIR_convolution conv,
+                     CAIR_energy ener,
+                     CML_int * V_Map,
+                     CML_int * H_Map,
+                     bool (*CAIR_callback)(float) );
+bool CAIR_Image_Map( CAIR_Context * context,
+                     CML_color * Source,
+                     CML_int * Weights,
+                     CAIR_convolution conv,
+                     CAIR_energy ener,
+                     CML_int * V_Map,
+                     CML_int * H_Map,
+                     bool (*CAIR_callback)(float) );
 
 //=========================================================================================================//
-//Experimental
-//An "example" function on how to decode the Map to quickly resize an image. This is only for the width, since multi-directional
-//resizing produces significant artifacts. Do note this will produce different results than standard CAIR(), because this resize doesn't
-//average pixels back into the image as does CAIR(). This function could be multi-threaded much like Remove_Path() for even faster performance.
-void CAIR_Map_Resize( CML_color * Source, CML_int * Map, int goal_x, CML_color * Dest );
-#endif
+//Resize Source into Dest at goal_x by goal_y using the maps from CAIR_Image_Map(). H_Map may be NULL, in which case the height
+//stays the same. Only shrinking is supported, and not below CAIR_MAP_MIN. Resizing both ways at once is an approximation, since
+//the two maps were made separately. Results differ slightly from CAIR(), because removed pixels aren't averaged back in.
+void CAIR_Map_Resize( CML_color * Source, CML_int * V_Map, CML_int * H_Map, int goal_x, int goal_y, CML_color * Dest );
+
+//=========================================================================================================//
+//Save the maps from CAIR_Image_Map() next to an image, so it can be resized later (or on another machine) without any of the
+//energy work. The file records the map format version, the convolution and energy settings, and a hash of Source, so a map
+//can't get used with the wrong image. Map values are stored in 16 bits when the image allows it. H_Map can be NULL.
+//Returns false if the maps don't match Source or the file couldn't be written.
+#define CAIR_MAP_VERSION 1
+struct CAIR_Map_Info
+{
+	int version;
+	int width;
+	int height;
+	CAIR_convolution conv;
+	CAIR_energy ener;
+	bool has_h_map;
+	unsigned long long source_hash;
+};
+bool CAIR_Save_Map( const char * filename, CML_color * Source, CML_int * V_Map, CML_int * H_Map, CAIR_convolution conv, CAIR_energy ener );
+
+//=========================================================================================================//
+//Load maps saved by CAIR_Save_Map() into V_Map and H_Map, ready for CAIR_Map_Resize(). If Source isn't NULL, the load fails
+//unless the map was made from that same image. H_Map is only filled in when the file has one (and H_Map isn't NULL); otherwise
+//it is left 1x1 and zero. Info (also optional) gets the header. Returns false on any error, including a newer format version,
+//unknown settings, or a file too short for the size in its header.
+bool CAIR_Load_Map( const char * filename, CML_color * Source, CML_int * V_Map, CML_int * H_Map, CAIR_Map_Info * Info );
+
+//Hash of the color channels of Source, as stored in map files.
+unsigned long long CAIR_Image_Hash( CML_color * Source );
 
 //=========================================================================================================//
 //This works as CAIR, except here maximum quality is attempted. When removing in both directions some amount, CAIR_HD()
@@ -133,5 +296,15 @@ bool CAIR_HD( CML_color * Source,
               CML_int * D_Weights,
               CML_color * Dest,
               bool (*CAIR_callback)(float) );
+bool CAIR_HD( CAIR_Context * context,
+              CML_color * Source,
+              CML_int * S_Weights,
+              int goal_x,
+              int goal_y,
+              CAIR_convolution conv,
+              CAIR_energy ener,
+              CML_int * D_Weights,
+              CML_color * Dest,
+              bool (*CAIR_callback)(float) );
 
 #endif //CAIR_H
@@ -31,7 +31,11 @@
 //=========================================================================================================//
 
 #include <cstring> //for memcpy(), memmove()
-#include <cstdlib> //for realloc()
+#include <cstdlib> //for posix_memalign(), free()
+#include <new> //for std::bad_alloc
+#ifdef _WIN32
+#include <malloc.h> //for _aligned_malloc(), _aligned_free()
+#endif
 
 //CML_DEBUG will print out information to the console window when CAIR tries
 // to step out-of-bounds of the matrix. For development purposes.
@@ -40,6 +44,17 @@
 #include <iostream>
 #endif
 
+//Define CML_HUGEPAGES (see cair.pri) to ask the kernel to back large matrices with transparent huge pages. Linux only, and off
+//unless you ask for it.
+#if defined(CML_HUGEPAGES) && defined(__linux__)
+#include <sys/mman.h> //for madvise()
+#endif
+
+//Every row starts on a CML_ALIGN byte boundary. With CML_HUGEPAGES, matrices of at least CML_HUGEPAGE_SIZE bytes are aligned to
+//that instead.
+#define CML_ALIGN 64
+#define CML_HUGEPAGE_SIZE (2*1024*1024)
+
 //=========================================================================================================//
 template <typename T>
 class CML_Matrix
@@ -49,21 +64,26 @@ public:
 	//Simple constructor.
 	CML_Matrix( int x, int y )
 	{
+		matrix = NULL;
+		capacity = 0;
+		external = false;
+		shifted = false;
+		rows = NULL;
+		row_count = 0;
 		Allocate_Matrix( x, y );
 		current_x = x;
 		current_y = y;
-		max_x = x;
-		max_y = y;
 	}
 	//=========================================================================================================//
 	//Simple destructor.
 	~CML_Matrix()
 	{
 		Deallocate_Matrix();
+		delete[] rows;
 	}
 
 	//=========================================================================================================//
-	//Assignment operator; not really fast, but it works reasonably well.
+	//Assignment operator. Reuses our memory when it's large enough.
 	//Does not copy Reserve()'ed memory.
 	CML_Matrix& operator= ( const CML_Matrix& input )
 	{
@@ -71,17 +91,21 @@ public:
 		{
 			return *this;
 		}
-		Deallocate_Matrix();
 		Allocate_Matrix( input.current_x, input.current_y );
 		current_x = input.current_x;
 		current_y = input.current_y;
-		max_x = current_x;
-		max_y = current_y;
 
-		for( int y = 0; y < current_y; y++ )
+		if( (stride == input.stride) && (input.shifted == false) )
 		{
 			//ahh, memcpy(), how I love thee
-			std::memcpy( &(matrix[y][0]), &(input.matrix[y][0]), current_x*sizeof(T) );
+			std::memcpy( matrix, input.matrix, (size_t)stride*current_y*sizeof(T) );
+		}
+		else
+		{
+			for( int y = 0; y < current_y; y++ )
+			{
+				std::memcpy( rows[y], input.rows[y], current_x*sizeof(T) );
+			}
 		}
 		return *this;
 	}
@@ -92,12 +116,11 @@ public:
 	//Make sure to do this for the weights.
 	void Fill( T value )
 	{
-		for( int y = 0; y < CML_Matrix::Height(); y++ )
+		//the row padding gets filled too, so this is one pass over the block
+		T * end = matrix + (size_t)stride*current_y;
+		for( T * element = matrix; element < end; element++ )
 		{
-			for( int x = 0; x < CML_Matrix::Width(); x++ )
-			{
-				matrix[y][x] = value; //remember, ROW MAJOR
-			}
+			*element = value;
 		}
 	}
 
@@ -112,7 +135,7 @@ public:
 			std::cout << "current_x=" << current_x << " current_y=" << current_y << std::endl;
 		}
 #endif
-		return matrix[y][x]; //remember, ROW MAJOR
+		return rows[y][x]; //remember, ROW MAJOR
 	}
 
 	//Returns the current image Width.
@@ -127,17 +150,92 @@ public:
 		return current_y;
 	}
 
+	//Returns the distance, in elements, between the start of two rows.
+	inline int Stride()
+	{
+		return stride;
+	}
+
+	//Returns the start of row y. The row is CML_ALIGN aligned, unless Remove_From_Row() moved its start.
+	inline T * Row( int y )
+	{
+		return rows[y];
+	}
+
+	//Returns how many bytes the matrix is holding on to, which can be more than its current size needs.
+	//Attach()'ed memory doesn't count, since it isn't ours.
+	inline size_t Bytes()
+	{
+		return ( external ? 0 : capacity * sizeof(T) ) + row_count * sizeof(T*);
+	}
+
+	//=========================================================================================================//
+	//Use someone else's memory as the matrix, like the pixels of a QImage, without copying it. data is x by y elements,
+	//with rows stride elements apart. The memory must outlive the matrix, or at least its next resize.
+	//Resizes that still fit keep using it; anything bigger moves the matrix into memory of its own.
+	void Attach( T * data, int x, int y, int stride )
+	{
+		Deallocate_Matrix();
+		matrix = data;
+		capacity = (size_t)stride * y;
+		external = true;
+		CML_Matrix::stride = stride;
+
+		if( y > row_count )
+		{
+			delete[] rows;
+			rows = new T*[y];
+			row_count = y;
+		}
+		for( int i = 0; i < y; i++ )
+		{
+			rows[i] = &(matrix[(size_t)i*stride]);
+		}
+		shifted = false;
+		current_x = x;
+		current_y = y;
+	}
+
+	//=========================================================================================================//
+	//Trades everything with other, so a matrix built elsewhere can take our place without being copied.
+	void Swap( CML_Matrix<T> & other )
+	{
+		Swap_Value( matrix, other.matrix );
+		Swap_Value( rows, other.rows );
+		Swap_Value( row_count, other.row_count );
+		Swap_Value( capacity, other.capacity );
+		Swap_Value( external, other.external );
+		Swap_Value( shifted, other.shifted );
+		Swap_Value( stride, other.stride );
+		Swap_Value( current_x, other.current_x );
+		Swap_Value( current_y, other.current_y );
+	}
+
 	//=========================================================================================================//
 	//Does a flip/rotate on Source and stores it into ourself.
 	void Transpose( CML_Matrix<T> * Source )
 	{
 		CML_Matrix::D_Resize( (*Source).Height(), (*Source).Width() );
 
-		for( int y = 0; y < (*Source).Height(); y++ )
+		//go in small tiles so both the reads and the writes stay in cache
+		const int tile = 32;
+		int height = (*Source).Height();
+		int width = (*Source).Width();
+		for( int top_y = 0; top_y < height; top_y += tile )
 		{
-			for( int x = 0; x < (*Source).Width(); x++ )
+			for( int top_x = 0; top_x < width; top_x += tile )
 			{
-				matrix[x][y] = (*Source)(x,y); //remember, ROW MAJOR
+				int bot_y = ( top_y + tile < height ) ? top_y + tile : height;
+				int bot_x = ( top_x + tile < width ) ? top_x + tile : width;
+
+				for( int y = top_y; y < bot_y; y++ )
+				{
+					T * row = (*Source).Row( y );
+					for( int x = top_x; x < bot_x; x++ )
+					{
+						rows[x][y] = row[x]; //remember, ROW MAJOR
+					}
+				}
 			}
 		}
 	}
@@ -162,19 +260,17 @@ public:
 		{
 			y = current_y - 1;
 		}
-		return matrix[y][x]; //remember, ROW MAJOR
+		return rows[y][x]; //remember, ROW MAJOR
 	}
 
 	//=========================================================================================================//
 	//Destructive resize of the matrix.
+	//The old block is kept when it's large enough, since its contents are up for grabs anyway.
 	void D_Resize( int x, int y )
 	{
-		Deallocate_Matrix();
 		Allocate_Matrix( x, y );
 		current_x = x;
 		current_y = y;
-		max_x = x;
-		max_y = y;
 	}
 
 	//=========================================================================================================//
@@ -182,28 +278,54 @@ public:
 	//Enlarging requires memory to be Reserve()'ed beforehand, for speed reasons.
 	void Resize_Width( int x )
 	{
-		if( x > max_x )
+		//the rows have to be back where they started before they can get longer
+		if( x > current_x )
+		{
+			Compact();
+		}
+		if( x > stride )
 		{
 			//a graceful, slow, way to handle when someone screws up
-			for( int i = 0; i < current_y; i++ )
+			T * old_matrix = matrix;
+			int old_stride = stride;
+			bool old_external = external;
+			matrix = NULL;
+			capacity = 0;
+			external = false;
+			Allocate_Matrix( x, current_y );
+
+			for( int y = 0; y < current_y; y++ )
 			{
-				matrix[i] = (T*)std::realloc( matrix[i], x*sizeof(T) );
+				std::memcpy( rows[y], &(old_matrix[(size_t)y*old_stride]), current_x*sizeof(T) );
+			}
+			if( old_external == false )
+			{
+				Free_Block( old_matrix );
 			}
-			max_x = x;
 		}
 		current_x = x;
 	}
 
+	//=========================================================================================================//
+	//Non-destructive resize, but only shrinking in the y direction. The rows past the new height are just forgotten.
+	void Resize_Height( int y )
+	{
+		if( y > current_y )
+		{
+			Compact();
+		}
+		if( y <= row_count )
+		{
+			current_y = y;
+		}
+	}
+
 	//=========================================================================================================//
 	//Destructive memory reservation for the internal matrix.
 	//The reported size of the image does not change.
 	void Reserve( int x, int y )
 	{
-		Deallocate_Matrix();
 		Allocate_Matrix( x, y );
-
-		max_x = x;
-		max_y = y;
 		//current_x and y didn't change
 	}
 
@@ -257,42 +379,280 @@ public:
 		}
 
 		//memmove because this WILL overlap
-		std::memmove( &(matrix[y][x_shift]), &(matrix[y][x]), shift_amount*sizeof(T) );
+		T * row = rows[y];
+		std::memmove( &(row[x_shift]), &(row[x]), shift_amount*sizeof(T) );
+	}
+
+	//=========================================================================================================//
+	//Removes the count elements listed in columns (sorted, no repeats) from row y, sliding the rest of the row left in one pass.
+	//Like Shift_Row(), the width doesn't change; Resize_Width() once all the rows are done.
+	void Remove_Columns( int y, int * columns, int count )
+	{
+		T * row = rows[y];
+		int write = columns[0];
+
+		for( int i = 0; i < count; i++ )
+		{
+			int start = columns[i] + 1;
+			int end = ( i + 1 < count ) ? columns[i+1] : current_x;
+			std::memmove( &(row[write]), &(row[start]), (end - start)*sizeof(T) );
+			write += end - start;
+		}
+	}
+
+	//=========================================================================================================//
+	//Removes element x from row y, which is width elements long, by moving whichever side of it is shorter over by one.
+	//That's half the copying Shift_Row() does on average. When it's the left side, the row now starts one element later,
+	//which is fine for anything going through Row() or (), since the row is never longer than it was. The width doesn't
+	//change; Resize_Width() once all the rows are done. The row is closed up right away, so it stays a plain array for
+	//everything reading it; Remove_Columns() is the way to take out several elements with one pass over the row.
+	void Remove_From_Row( int x, int y, int width )
+	{
+		T * row = rows[y];
+		if( x < width - 1 - x )
+		{
+			std::memmove( &(row[1]), &(row[0]), x*sizeof(T) );
+			rows[y] = row + 1;
+			shifted = true;
+		}
+		else
+		{
+			std::memmove( &(row[x]), &(row[x+1]), (width - 1 - x)*sizeof(T) );
+		}
+	}
+
+	//=========================================================================================================//
+	//Moves any rows Remove_From_Row() left starting late back to the start of their stride, in one pass.
+	//Done before the matrix grows, since a moved row has no room left at its end.
+	void Compact()
+	{
+		if( shifted == false )
+		{
+			return;
+		}
+
+		int allocated = (int)(capacity / stride);
+		if( allocated > row_count )
+		{
+			allocated = row_count;
+		}
+		for( int y = 0; y < allocated; y++ )
+		{
+			T * home = &(matrix[(size_t)y*stride]);
+			if( (rows[y] != home) && (y < current_y) )
+			{
+				std::memmove( home, rows[y], current_x*sizeof(T) );
+			}
+			rows[y] = home;
+		}
+		shifted = false;
 	}
 
 private:
 	//=========================================================================================================//
-	//Simple row-major 2D allocation algorithm.
-	//The size variables must be assigned seperately.
+	//Row-major 2D allocation in one aligned block, with each row padded out to the alignment.
+	//The row table just points into the block, so access looks the same as it did with separate rows.
+	//The current size variables must be assigned seperately. The block is only replaced if it's too small.
 	void Allocate_Matrix( int x, int y )
 	{
-		matrix = new T*[y];
+		if( x < 1 ) x = 1;
+		if( y < 1 ) y = 1;
+
+		//Attach()'ed memory keeps its own layout for as long as we fit in it
+		bool fits = false;
+		if( external == true )
+		{
+			fits = (x <= stride) && ((size_t)stride * y <= capacity);
+			if( fits == false )
+			{
+				Deallocate_Matrix();
+			}
+		}
 
+		if( fits == false )
+		{
+			//pad the row out to the alignment, when the type allows it
+			stride = x;
+			if( (CML_ALIGN % sizeof(T)) == 0 )
+			{
+				int per_line = CML_ALIGN / sizeof(T);
+				stride = ((x + per_line - 1) / per_line) * per_line;
+			}
+
+			size_t needed = (size_t)stride * y;
+			if( needed > capacity )
+			{
+				Deallocate_Matrix();
+				matrix = Allocate_Block( needed*sizeof(T) );
+				capacity = needed;
+			}
+		}
+
+		if( y > row_count )
+		{
+			delete[] rows;
+			rows = new T*[y];
+			row_count = y;
+		}
 		for( int i = 0; i < y; i++ )
 		{
-			matrix[i] = new T[x];
+			rows[i] = &(matrix[(size_t)i*stride]);
 		}
+		shifted = false;
+	}
+	template <typename V>
+	static void Swap_Value( V & a, V & b )
+	{
+		V temp = a;
+		a = b;
+		b = temp;
 	}
-	//Simple row-major 2D deallocation algorithm.
+
+	//Simple deallocation.
 	//Doest not maintain size variables.
 	void Deallocate_Matrix()
 	{
-		for( int i = 0; i < max_y; i++ )
+		if( external == false )
 		{
-			delete[] matrix[i];
+			Free_Block( matrix );
 		}
+		matrix = NULL;
+		capacity = 0;
+		external = false;
+	}
 
-		delete[] matrix;
+	//=========================================================================================================//
+	//Platform specific aligned allocation. With CML_HUGEPAGES, big blocks are huge page aligned and handed to madvise() where we can.
+	static T * Allocate_Block( size_t bytes )
+	{
+		size_t alignment = CML_ALIGN;
+#ifdef CML_HUGEPAGES
+		if( bytes >= CML_HUGEPAGE_SIZE )
+		{
+			alignment = CML_HUGEPAGE_SIZE;
+		}
+#endif
+
+		void * block = NULL;
+#ifdef _WIN32
+		block = _aligned_malloc( bytes, alignment );
+#else
+		if( posix_memalign( &block, alignment, bytes ) != 0 )
+		{
+			block = NULL;
+		}
+#endif
+		if( block == NULL )
+		{
+			throw std::bad_alloc();
+		}
+
+#if defined(CML_HUGEPAGES) && defined(__linux__) && defined(MADV_HUGEPAGE)
+		if( bytes >= CML_HUGEPAGE_SIZE )
+		{
+			madvise( block, bytes, MADV_HUGEPAGE ); //just a hint, so failure is fine
+		}
+#endif
+		return (T*)block;
+	}
+	static void Free_Block( T * block )
+	{
+#ifdef _WIN32
+		_aligned_free( block );
+#else
+		std::free( block );
+#endif
 	}
 
-	T ** matrix;
+	T * matrix;
+	T ** rows;
+	int row_count;
+	size_t capacity; //in elements
+	bool external; //matrix came from Attach(), so it isn't ours to free
+	bool shifted; //Remove_From_Row() has moved the start of some rows, see Compact()
+	int stride;
 	int current_x;
 	int current_y;
-	int max_x;
-	int max_y;
 };
 
 
+//=========================================================================================================//
+//A transposed look at a CML_Matrix without moving anything: (x,y) of the view is (y,x) of the matrix.
+//Has just enough of the CML_Matrix interface for code templated on the matrix type to run on it.
+template <typename T>
+class CML_Transposed
+{
+public:
+	CML_Transposed( CML_Matrix<T> * Matrix )
+	{
+		matrix = Matrix;
+	}
+
+	inline T& operator()( int x, int y )
+	{
+		return (*matrix)(y,x);
+	}
+
+	inline T Get( int x, int y )
+	{
+		return (*matrix).Get(y,x);
+	}
+
+	inline int Width()
+	{
+		return (*matrix).Height();
+	}
+
+	inline int Height()
+	{
+		return (*matrix).Width();
+	}
+
+private:
+	CML_Matrix<T> * matrix;
+};
+
+
+//=========================================================================================================//
+//A look at a band of columns of a CML_Matrix: (x,y) of the view is (left+x,y) of the matrix, for x below width.
+//Like CML_Transposed, it's there so code templated on the matrix type can work on part of a matrix in place.
+template <typename T>
+class CML_Band
+{
+public:
+	CML_Band( CML_Matrix<T> * Matrix, int left, int width )
+	{
+		matrix = Matrix;
+		CML_Band::left = left;
+		CML_Band::width = width;
+	}
+
+	inline T& operator()( int x, int y )
+	{
+		return (*matrix)(left+x,y);
+	}
+
+	inline T Get( int x, int y )
+	{
+		return (*matrix).Get(left+x,y);
+	}
+
+	inline int Width()
+	{
+		return width;
+	}
+
+	inline int Height()
+	{
+		return (*matrix).Height();
+	}
+
+private:
+	CML_Matrix<T> * matrix;
+	int left;
+	int width;
+};
+
 //=========================================================================================================//
 typedef unsigned char CML_byte;
 
@@ -306,6 +666,7 @@ struct CML_RGBA
 };
 
 typedef CML_Matrix<CML_RGBA> CML_color; //use for images
+typedef CML_Matrix<CML_byte> CML_gray; //use for grayscale images
 typedef CML_Matrix<int> CML_int; //use for weights
 
 #endif //CAIR_CML_H
@@ -2,6 +2,9 @@
 
 DEFINES += BACKEND_CAIR
 
+# Uncomment to back large images with transparent huge pages (Linux only)
+#DEFINES += CML_HUGEPAGES
+
 SOURCES += \
 	   $$PWD/CAIR.cpp 
 
@@ -30,46 +30,165 @@
 //Decent MAX_ATTEMPTS value
 #define MAX_ATTEMPTS 5
 
-QProgressDialog *gProg;
-bool updateCallback(float percDone)
+//CML_RGBA pixels are laid out just like Format_RGBA8888. When Qt has that format, images are
+//kept in it so CAIR can read and write their pixels where they are, with no conversion.
+#if QT_VERSION >= 0x050200
+#define CAIR_QIMAGE_DIRECT
+#endif
+
+//The format we keep images in.
+static QImage toCairFormat(const QImage &image)
 {
-  qApp->processEvents();
-  gProg->setValue((int)(percDone*100));
-  if(gProg->wasCanceled())
-    return false; //exit out
-  return true;
+#ifdef CAIR_QIMAGE_DIRECT
+  return image.convertToFormat(QImage::Format_RGBA8888); //no copy if it already is
+#else
+  return image;
+#endif
 }
 
-//assumes dest is already set to have the save size as source
-static void QImagetoCML(QImage source, CML_color &dest)
+//Hand source over to CAIR. If it's in the direct format, dest just points at its pixels,
+//so source must stay around (and unchanged) for as long as dest is used.
+static void QImagetoCML(QImage &source, CML_color &dest)
 {
+#ifdef CAIR_QIMAGE_DIRECT
+  if(source.format() == QImage::Format_RGBA8888)
+  {
+    //bits() first gives source pixels of its own if it shares them with another QImage
+    dest.Attach((CML_RGBA *)source.bits(), source.width(), source.height(), source.bytesPerLine() / sizeof(CML_RGBA));
+    return;
+  }
+#endif
+  QImage argb = source.convertToFormat(QImage::Format_ARGB32);
+  dest.D_Resize(argb.width(), argb.height());
   CML_RGBA p;
-  for( int j=0; j<source.height(); j++ )
+  for( int j=0; j<argb.height(); j++ )
   {
-    for( int i=0; i<source.width(); i++ )
+    const QRgb *line = (const QRgb *)argb.scanLine(j);
+    for( int i=0; i<argb.width(); i++ )
     {
-      p.red = qRed( source.pixel(i, j) );
-      p.green = qGreen( source.pixel(i, j) );
-      p.blue = qBlue( source.pixel(i, j) );
-      p.alpha = qAlpha( source.pixel(i, j) );
+      p.red = qRed( line[i] );
+      p.green = qGreen( line[i] );
+      p.blue = qBlue( line[i] );
+      p.alpha = qAlpha( line[i] );
       dest(i,j) = p;
     }
   }
 }
 
-static QImage CMLtoQImage(CML_color &source)
+//Make a new image of the given size for CAIR to put its result in, pointing dest at it when
+//we can. Hand both to CMLtoQImage() afterwards.
+static QImage newCMLImage(int width, int height, CML_color &dest)
+{
+#ifdef CAIR_QIMAGE_DIRECT
+  QImage image(width, height, QImage::Format_RGBA8888);
+  dest.Attach((CML_RGBA *)image.bits(), width, height, image.bytesPerLine() / sizeof(CML_RGBA));
+  return image;
+#else
+  Q_UNUSED(dest);
+  return QImage(width, height, QImage::Format_ARGB32);
+#endif
+}
+
+//Get the result out of source. If CAIR wrote it straight into target (from newCMLImage()),
+//that's it, otherwise it's copied out. The alpha channel is kept either way.
+static QImage CMLtoQImage(CML_color &source, QImage target = QImage())
 {
+#ifdef CAIR_QIMAGE_DIRECT
+  const QImage &constTarget = target;
+  if(!target.isNull() && target.width() == source.Width() && target.height() == source.Height() &&
+     (const uchar *)source.Row(0) == constTarget.bits())
+  {
+    return target;
+  }
+#endif
+  QImage newImg = QImage(source.Width(), source.Height(), QImage::Format_ARGB32);
   CML_RGBA p;
-  QImage newImg = QImage(source.Width(), source.Height(), QImage::Format_RGB32);
   for( int j=0; j<source.Height(); j++ )
   {
+    QRgb *line = (QRgb *)newImg.scanLine(j);
     for( int i=0; i<source.Width(); i++ )
     {
       p = source(i,j);
-      newImg.setPixel(i, j, qRgba( p.red, p.green, p.blue, p.alpha ));
+      line[i] = qRgba( p.red, p.green, p.blue, p.alpha );
     }
   }
-  return newImg;
+  return toCairFormat(newImg);
+}
+
+/// CAIR's callback has no user data, but only one job runs at a time
+static CarveWorker *gWorker;
+
+//Our own context, so the GUI thread can still use the default one for its views
+CarveWorker::CarveWorker(QObject *parent)
+  : QThread(parent), _context(CAIR_Create_Context(CAIR_NUM_THREADS)), _resultWeights(1,1), _vMap(1,1), _hMap(1,1), _cancelRequested(0), _canceled(false), _lastPercent(-1)
+{
+}
+
+CarveWorker::~CarveWorker()
+{
+  cancel();
+  wait();
+  CAIR_Destroy_Context(_context);
+}
+
+void CarveWorker::carve()
+{
+  _cancelRequested.fetchAndStoreOrdered(0);
+  _canceled = false;
+  _lastPercent = -1;
+  start();
+}
+
+void CarveWorker::cancel()
+{
+  _cancelRequested.fetchAndStoreOrdered(1);
+}
+
+//Called by CAIR after every seam, so this only passes on whole percents
+bool CarveWorker::callback(float percDone)
+{
+  int percent = (int)(percDone*100);
+  if(percent != gWorker->_lastPercent)
+  {
+    gWorker->_lastPercent = percent;
+    emit gWorker->progress(percent);
+  }
+  return gWorker->_cancelRequested.fetchAndAddOrdered(0) == 0; //an ordered read on every Qt version
+}
+
+void CarveWorker::run()
+{
+  gWorker = this;
+  CML_color source(1,1);
+  CML_color dest(1,1);
+  QImagetoCML(_job.image, source); //copies the pixels _job.image still shares with the GUI's image
+  if(_job.mode == CarveJob::Map)
+  {
+    _canceled = !CAIR_Image_Map( _context, &source, &_job.weights, _job.conv, _job.ener, &_vMap, &_hMap, callback );
+    _result = QImage();
+    return;
+  }
+  //CAIR only gives up early when callback() tells it to, so a job that got to the end keeps its result
+  //even if Cancel was pressed just after
+  bool done;
+  if(_job.mode == CarveJob::Remove)
+  {
+    _result = newCMLImage(_job.image.width(), _job.image.height(), dest); //removal comes back to the same size
+    done = CAIR_Removal( _context, &source, &_job.weights, _job.choice, _job.attempts, _job.conv, _job.ener, &_resultWeights, &dest, callback );
+  }
+  else
+  {
+    _result = newCMLImage(_job.goalWidth, _job.goalHeight, dest);
+    if(_job.mode == CarveJob::Resize)
+      done = CAIR( _context, &source, &_job.weights, _job.goalWidth, _job.goalHeight, _job.conv, _job.ener, &_resultWeights, &dest, callback );
+    else
+      done = CAIR_HD( _context, &source, &_job.weights, _job.goalWidth, _job.goalHeight, _job.conv, _job.ener, &_resultWeights, &dest, callback );
+  }
+  _canceled = !done;
+  if(_canceled)
+    _result = QImage();
+  else
+    _result = CMLtoQImage(dest, _result);
 }
 
 
@@ -96,8 +215,10 @@ void ImageScene::mousePressEvent(QGraphicsSceneMouseEvent * e )
 }
 
 MainWindow::MainWindow()
-  : _imgItem(0), _maskItem(0), _undoStackPos(0)
+  : _imgItem(0), _maskItem(0), _undoStackPos(0), _mapValid(false), _previewSource(1,1), _previewDest(1,1)
 {
+  _worker = new CarveWorker(this);
+
   //Create an image filter
   _filter = "Images (";
   QList<QByteArray> formats = QImageWriter::supportedImageFormats();
@@ -137,6 +258,13 @@ MainWindow::MainWindow()
   connect(_resizeWidget.clearButton, SIGNAL(clicked()), this, SLOT(clearMask()));
   connect(_resizeWidget.brushSizeSlider, SIGNAL(sliderMoved(int)), this, SLOT(updateCursor()));
   connect(_resizeWidget.edgeDetector, SIGNAL(activated(int)), this, SLOT(updateView()));
+  connect(_resizeWidget.edgeDetector, SIGNAL(activated(int)), this, SLOT(invalidatePreview()));
+  connect(_resizeWidget.energyCheckBox, SIGNAL(toggled(bool)), this, SLOT(invalidatePreview()));
+  connect(_resizeWidget.weightScaleLineEdit, SIGNAL(textChanged(QString)), this, SLOT(invalidatePreview())); //both go into weightScale()
+  connect(_resizeWidget.brushWeightSlider, SIGNAL(valueChanged(int)), this, SLOT(invalidatePreview()));
+  connect(_resizeWidget.previewCheckBox, SIGNAL(toggled(bool)), this, SLOT(togglePreview(bool)));
+  connect(_resizeWidget.widthSlider, SIGNAL(valueChanged(int)), this, SLOT(updatePreview()));
+  connect(_resizeWidget.heightSlider, SIGNAL(valueChanged(int)), this, SLOT(updatePreview()));
   _resizeDock->setWidget(holderWidget);
   holderWidget->resize(50,50);
   addDockWidget(Qt::RightDockWidgetArea, _resizeDock);
@@ -160,6 +288,10 @@ MainWindow::MainWindow()
   QString removeToolTip = tr(
     "Resize the image in one dimension to remove all the areas marked for\n"
     "removal and then resize the image back to its original dimensions.");
+  QString previewToolTip = tr(
+    "Work out once the order seams would be removed in, then drag the sliders\n"
+    "to see the image at any smaller size right away. The preview is a little\n"
+    "rougher than the real thing; press Resize to carve the chosen size.");
     
   _resizeWidget.weightScaleLabel->setToolTip(weightScaleToolTip);
   _resizeWidget.weightScaleLineEdit->setToolTip(weightScaleToolTip);
@@ -167,10 +299,31 @@ MainWindow::MainWindow()
   _resizeWidget.removeButton->setToolTip(removeToolTip);
   _resizeWidget.hdCheckBox->setToolTip(hdToolTip);
   _resizeWidget.energyCheckBox->setToolTip(energyToolTip);
+  _resizeWidget.previewCheckBox->setToolTip(previewToolTip);
+  _resizeWidget.widthSlider->setToolTip(previewToolTip);
+  _resizeWidget.heightSlider->setToolTip(previewToolTip);
+
+  //Progress of a running resize, out of the way so the image can still be looked around
+  _progressBar = new QProgressBar(this);
+  _progressBar->setRange(0, 100);
+  _progressBar->hide();
+  _cancelButton = new QPushButton(tr("&Cancel"), this);
+  _cancelButton->hide();
+  statusBar()->addPermanentWidget(_progressBar);
+  statusBar()->addPermanentWidget(_cancelButton);
+  connect(_worker, SIGNAL(progress(int)), _progressBar, SLOT(setValue(int)));
+  connect(_worker, SIGNAL(finished()), this, SLOT(carveFinished()));
+  connect(_cancelButton, SIGNAL(clicked()), _worker, SLOT(cancel()));
 
   resize(700, 400);
 }
 
+MainWindow::~MainWindow()
+{
+  //the worker's destructor stops any job still running
+  delete _worker;
+}
+
 void MainWindow::open()
 {
   QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), QDir::currentPath(), _filter);
@@ -192,7 +345,8 @@ void MainWindow::openFile(QString fileName)
 
 void MainWindow::openImage(QImage image, QPixmap mask)
 {
-  _img = image;
+  invalidatePreview();
+  _img = toCairFormat(image);
   delete _scene;
     
   _scene = new ImageScene(this);
@@ -270,6 +424,7 @@ void MainWindow::openMask()
           mskImg.setPixel( i, j, qRgba(0, 0, 0, 0) );
       }
     }
+    invalidatePreview();
     _maskPix = QPixmap::fromImage(mskImg);
     _maskItem->setPixmap(_maskPix);
   }
@@ -333,6 +488,8 @@ void MainWindow::dragEnterEvent(QDragEnterEvent *event)
 
 void MainWindow::dropEvent(QDropEvent *event)
 {
+  if(_worker->isRunning())
+    return;
   if(event->mimeData()->hasUrls())
   {
     QList<QUrl> urls = event->mimeData()->urls();
@@ -387,52 +544,23 @@ void MainWindow::removeButtonClicked()
 
 void MainWindow::cairRemove()
 {
-  int width = _img.width();
-  int height = _img.height();
-  int weight_scale = (int)(_resizeWidget.weightScaleLineEdit->text().toInt() * (_resizeWidget.brushWeightSlider->value() / 100.0));
-  int attempts = _resizeWidget.iterateCheckBox->isChecked() ? MAX_ATTEMPTS : 1;
-  CAIR_convolution conv = V1;
-  switch( _resizeWidget.edgeDetector->currentIndex() )
-  {
-    case 0 : conv = V1; break;
-    case 1 : conv = V_SQUARE; break;
-    case 2 : conv = PREWITT; break;
-    case 3 : conv = SOBEL; break;
-    case 4 : conv = LAPLACIAN; break;
-  }
-
-  CAIR_energy ener = BACKWARD;
-  if( _resizeWidget.energyCheckBox->isChecked() )
-  {
-    ener = FORWARD;
-  }
+  if(_worker->isRunning())
+    return;
+  CarveJob &job = _worker->job();
+  job.mode = CarveJob::Remove;
+  job.attempts = _resizeWidget.iterateCheckBox->isChecked() ? MAX_ATTEMPTS : 1;
+  job.conv = convolution();
+  job.ener = energy();
 
-  CAIR_direction choice = AUTO;
+  job.choice = AUTO;
   if(_resizeWidget.removeMode->currentIndex() == 1)
-    choice = VERTICAL;
+    job.choice = VERTICAL;
   else if(_resizeWidget.removeMode->currentIndex() == 2)
-    choice = HORIZONTAL;
+    job.choice = HORIZONTAL;
 
-  //Transfer the image over to cair image format.
-  CML_color source(width, height);
-  CML_color dest(1,1);
-  CML_int source_weights(width, height);
-  CML_int dest_weights(1,1);
-  QImagetoCML(_img,source);
-  QImage mskImg = _maskPix.toImage();
-  for( int j=0; j<height; j++ )
-  {
-    for( int i=0; i<width; i++ )
-    {
-      QRgb m = mskImg.pixel(i,j);
-      if(qGreen(m) > 0)
-        source_weights(i,j) = (int)(qGreen(m) * weight_scale);
-      else if(qRed(m) > 0)
-        source_weights(i,j) = (int)(qRed(m) * -weight_scale);
-      else
-        source_weights(i,j) = 0;
-    }
-  }
+  job.weightScale = weightScale();
+  maskToWeights(job.weights, job.weightScale);
+  CML_int &source_weights = job.weights;
 
   int negative_x = 0;
   int negative_y = 0;
@@ -464,23 +592,23 @@ void MainWindow::cairRemove()
     }
   }
 
-  switch( choice )
+  switch( job.choice )
   {
   case AUTO :
     if( negative_x > negative_y )
     {
-      total_time = negative_y * 2 * attempts;
+      total_time = negative_y * 2 * job.attempts;
     }
     else
     {
-      total_time = negative_x * 2 * attempts;
+      total_time = negative_x * 2 * job.attempts;
     }
     break;
   case HORIZONTAL :
-    total_time = negative_y * 2 * attempts;
+    total_time = negative_y * 2 * job.attempts;
     break;
   case VERTICAL :
-    total_time = negative_x * 2 * attempts;
+    total_time = negative_x * 2 * job.attempts;
     break;
   }
 
@@ -491,44 +619,161 @@ void MainWindow::cairRemove()
     return;
   }
 
-  QProgressDialog prog("Removing...", "&Cancel", 0, 100, this);
-  gProg = &prog;
-  qApp->processEvents();
+  startCarve();
+}
 
-  //Call CAIR
-  CAIR_Removal( &source, &source_weights, choice, attempts, conv, ener, &dest_weights, &dest, updateCallback );
-  if(prog.wasCanceled())
+void MainWindow::cairResize(int newWidth, int newHeight)
+{
+  if(_worker->isRunning())
     return;
-  QImage newImg = CMLtoQImage(dest);
-  saveInUndoStack(); //Old image
-  _img = newImg;
-  _imgItem->setPixmap(QPixmap::fromImage(_img));
-  //Set the weight mask to the now reduced size version shrunk by CAIR
-  QImage maskImg(_img.width(), _img.height(), QImage::Format_ARGB32);
-  maskImg.fill(qRgba(0,0,0,0));
-  for( int j=0; j<_img.height(); j++ )
+  int width = _img.width();
+  int height = _img.height();
+
+  if(newWidth < 1 || newHeight < 1)
   {
-    for( int i=0; i<_img.width(); i++ )
+    QMessageBox::information(this, tr("Seam Carving GUI"),
+                             tr("Invalid dimensions."));
+    return;
+  }
+  if(width == newWidth && height == newHeight)
+    return;
+
+  CarveJob &job = _worker->job();
+  job.mode = _resizeWidget.hdCheckBox->isChecked() ? CarveJob::ResizeHD : CarveJob::Resize;
+  job.goalWidth = newWidth;
+  job.goalHeight = newHeight;
+  job.conv = convolution();
+  job.ener = energy();
+  job.weightScale = weightScale();
+  maskToWeights(job.weights, job.weightScale);
+
+  startCarve();
+}
+
+//Hand the current image over to the worker. Everything that would change the image is
+//turned off until carveFinished(), but it can still be viewed, zoomed and scrolled around.
+void MainWindow::startCarve()
+{
+  if(_worker->job().mode != CarveJob::Map)
+    _resizeWidget.previewCheckBox->setChecked(false);
+  _worker->job().image = _img;
+  setBusy(true);
+  _worker->carve();
+}
+
+void MainWindow::setBusy(bool busy)
+{
+  _resizeDock->setEnabled(!busy);
+  _openAct->setEnabled(!busy);
+  _openMaskAct->setEnabled(!busy);
+  _pasteAct->setEnabled(!busy);
+  _undoAct->setEnabled( !busy && _undoStackPos > 0 );
+  _repeatAct->setEnabled( !busy && _undoStackPos < _undoStackImg.size()-1 );
+  setAcceptDrops(!busy);
+  _progressBar->setValue(0);
+  _progressBar->setVisible(busy);
+  _cancelButton->setVisible(busy);
+}
+
+//Back on the GUI thread with the worker done
+void MainWindow::carveFinished()
+{
+  setBusy(false);
+  _worker->job().image = QImage();
+  if(_worker->job().mode == CarveJob::Map)
+  {
+    if(_worker->wasCanceled())
     {
-      if(dest_weights(i,j) > 0)
-        maskImg.setPixel(i, j, qRgba( 0, dest_weights(i,j) / weight_scale, 0, dest_weights(i,j) / weight_scale));
-      else if(dest_weights(i,j) < 0)
-        maskImg.setPixel(i, j, qRgba( dest_weights(i,j) / -weight_scale, 0, 0, dest_weights(i,j) / -weight_scale));
+      _resizeWidget.previewCheckBox->setChecked(false);
+      return;
     }
+    _mapValid = true;
+    togglePreview(_resizeWidget.previewCheckBox->isChecked());
+    return;
   }
-  _maskPix = QPixmap::fromImage(maskImg);
-  _maskItem->setPixmap(_maskPix);
+  if(_worker->wasCanceled())
+    return;
+  invalidatePreview();
+  saveInUndoStack(); //Old image
+  _img = _worker->result();
+  _imgItem->setPixmap(QPixmap::fromImage(_img));
+  //Set the weight mask to the now reduced size version shrunk by CAIR
+  weightsToMask(_worker->resultWeights(), _worker->job().weightScale);
   _scaleFactor = 1.0;
   _resizeWidget.heightLineEdit->setText(QString::number(_img.height()));
   _resizeWidget.widthLineEdit->setText(QString::number(_img.width()));
   addToUndoStack(); //New image
 }
 
-void MainWindow::cairResize(int newWidth, int newHeight)
+//The live preview. The seam order is worked out once in the background (CAIR_Image_Map()),
+//after which any smaller size is just a CAIR_Map_Resize() away, fast enough to follow the sliders.
+void MainWindow::togglePreview(bool on)
+{
+  if(_img.isNull())
+  {
+    _resizeWidget.previewCheckBox->setChecked(false); //nothing to preview, or to put the mask back on, yet
+    return;
+  }
+  if(on && !_mapValid)
+  {
+    if(_worker->isRunning())
+      return;
+    CarveJob &job = _worker->job();
+    job.mode = CarveJob::Map;
+    job.conv = convolution();
+    job.ener = energy();
+    job.weightScale = weightScale();
+    maskToWeights(job.weights, job.weightScale);
+    startCarve(); //comes back through carveFinished()
+    return;
+  }
+
+  _resizeWidget.widthSlider->setEnabled(on);
+  _resizeWidget.heightSlider->setEnabled(on);
+  _maskItem->setVisible(!on); //the mask only fits the full size image
+  if(!on)
+  {
+    updateView(); //back to the full size image
+    return;
+  }
+
+  QImagetoCML(_img, _previewSource); //_img stays as it is for as long as the preview is up
+  int width = qBound(CAIR_MAP_MIN, _resizeWidget.widthLineEdit->text().toInt(), _img.width());
+  int height = qBound(CAIR_MAP_MIN, _resizeWidget.heightLineEdit->text().toInt(), _img.height());
+  _resizeWidget.widthSlider->blockSignals(true);
+  _resizeWidget.heightSlider->blockSignals(true);
+  _resizeWidget.widthSlider->setRange(CAIR_MAP_MIN, _img.width());
+  _resizeWidget.heightSlider->setRange(CAIR_MAP_MIN, _img.height());
+  _resizeWidget.widthSlider->setValue(width);
+  _resizeWidget.heightSlider->setValue(height);
+  _resizeWidget.widthSlider->blockSignals(false);
+  _resizeWidget.heightSlider->blockSignals(false);
+  updatePreview();
+}
+
+void MainWindow::updatePreview()
+{
+  if(!_mapValid || !_resizeWidget.previewCheckBox->isChecked())
+    return;
+  int width = _resizeWidget.widthSlider->value();
+  int height = _resizeWidget.heightSlider->value();
+  _resizeWidget.widthLineEdit->setText(QString::number(width));
+  _resizeWidget.heightLineEdit->setText(QString::number(height));
+
+  QImage destImg = newCMLImage(width, height, _previewDest);
+  CAIR_Map_Resize( &_previewSource, &_worker->vMap(), &_worker->hMap(), width, height, &_previewDest );
+  _imgItem->setPixmap(QPixmap::fromImage(CMLtoQImage(_previewDest, destImg)));
+}
+
+//Anything that changes the image, mask, or energy settings makes the seam order out of date
+void MainWindow::invalidatePreview()
+{
+  _mapValid = false;
+  _resizeWidget.previewCheckBox->setChecked(false);
+}
+
+CAIR_convolution MainWindow::convolution()
 {
-  int width = _img.width();
-  int height = _img.height();
-  int weight_scale = (int)(_resizeWidget.weightScaleLineEdit->text().toInt() * (_resizeWidget.brushWeightSlider->value() / 100.0));
   CAIR_convolution conv = V1;
   switch( _resizeWidget.edgeDetector->currentIndex() )
   {
@@ -538,84 +783,64 @@ void MainWindow::cairResize(int newWidth, int newHeight)
     case 3 : conv = SOBEL; break;
     case 4 : conv = LAPLACIAN; break;
   }
+  return conv;
+}
 
+CAIR_energy MainWindow::energy()
+{
   CAIR_energy ener = BACKWARD;
   if( _resizeWidget.energyCheckBox->isChecked() )
   {
     ener = FORWARD;
   }
+  return ener;
+}
 
-  if(newWidth < 1 || newHeight < 1)
-  {
-    QMessageBox::information(this, tr("Seam Carving GUI"),
-                             tr("Invalid dimensions."));
-    return;
-  }
-  if(width == newWidth && height == newHeight)
-    return;
+int MainWindow::weightScale()
+{
+  return (int)(_resizeWidget.weightScaleLineEdit->text().toInt() * (_resizeWidget.brushWeightSlider->value() / 100.0));
+}
 
-  //int widthAdjustment = (width < newWidth ? newWidth - width : width - newWidth);
-  //int heightAdjustment = (height < newHeight ? newHeight - height : height - newHeight);
-  QProgressDialog prog("Resizing...", "&Cancel", 0, 100, this);
-  gProg = &prog;
-  qApp->processEvents();
-  
-  //Transfer the image over to cair image format.
-  CML_color source(width, height);
-  CML_color dest(1, 1);
-  CML_int source_weights(width, height);
-  CML_int dest_weights(1,1);
-  QImagetoCML(_img,source);
+void MainWindow::maskToWeights(CML_int &weights, int weight_scale)
+{
+  weights.D_Resize(_img.width(), _img.height());
   QImage mskImg = _maskPix.toImage();
-  for( int j=0; j<height; j++ )
+  for( int j=0; j<_img.height(); j++ )
   {
-    for( int i=0; i<width; i++ )
+    for( int i=0; i<_img.width(); i++ )
     {
       QRgb m = mskImg.pixel(i,j);
       if(qGreen(m) > 0)
-        source_weights(i,j) = (int)(qGreen(m) * weight_scale);
+        weights(i,j) = (int)(qGreen(m) * weight_scale);
       else if(qRed(m) > 0)
-        source_weights(i,j) = (int)(qRed(m) * -weight_scale);
+        weights(i,j) = (int)(qRed(m) * -weight_scale);
       else
-        source_weights(i,j) = 0;
+        weights(i,j) = 0;
     }
   }
-  //Call CAIR
-  if( !_resizeWidget.hdCheckBox->isChecked() )
-  {
-    CAIR( &source, &source_weights, newWidth, newHeight, conv, ener, &dest_weights, &dest, updateCallback );
-  }
-  else
-  {
-    CAIR_HD( &source, &source_weights, newWidth, newHeight, conv, ener, &dest_weights, &dest, updateCallback );
-  }
-  if(prog.wasCanceled())
-    return;
-  QImage newImg = CMLtoQImage(dest);
-  saveInUndoStack();
-  _img = newImg;
-  _imgItem->setPixmap(QPixmap::fromImage(_img));
-  //Set the weight mask to the now reduced size version shrunk by CAIR
-  QImage maskImg(_img.width(), _img.height(), QImage::Format_ARGB32);
+}
+
+void MainWindow::weightsToMask(CML_int &weights, int weight_scale)
+{
+  QImage maskImg(weights.Width(), weights.Height(), QImage::Format_ARGB32);
   maskImg.fill(qRgba(0,0,0,0));
-  for( int j=0; j<_img.height(); j++ )
+  for( int j=0; j<weights.Height(); j++ )
   {
-    for( int i=0; i<_img.width(); i++ )
+    for( int i=0; i<weights.Width(); i++ )
     {
-      if(dest_weights(i,j) > 0)
-        maskImg.setPixel(i, j, qRgba( 0, dest_weights(i,j) / weight_scale, 0, dest_weights(i,j) / weight_scale));
-      else if(dest_weights(i,j) < 0)
-        maskImg.setPixel(i, j, qRgba( dest_weights(i,j) / -weight_scale, 0, 0, dest_weights(i,j) / -weight_scale));
+      if(weights(i,j) > 0)
+        maskImg.setPixel(i, j, qRgba( 0, weights(i,j) / weight_scale, 0, weights(i,j) / weight_scale));
+      else if(weights(i,j) < 0)
+        maskImg.setPixel(i, j, qRgba( weights(i,j) / -weight_scale, 0, 0, weights(i,j) / -weight_scale));
     }
   }
   _maskPix = QPixmap::fromImage(maskImg);
   _maskItem->setPixmap(_maskPix);
-  _scaleFactor = 1.0;
-  addToUndoStack(); //new image
 }
 
 void MainWindow::clearMask()
 {
+  invalidatePreview();
   _maskPix = QPixmap(_img.width(), _img.height());
   _maskPix.fill(Qt::transparent);
   _maskItem->setPixmap(_maskPix);
@@ -623,6 +848,11 @@ void MainWindow::clearMask()
 
 void MainWindow::paintMask(QPointF oldPos, QPointF newPos)
 {
+  if(_worker->isRunning())
+    return; //the mask is replaced by the result's when it's done
+  if(_resizeWidget.previewCheckBox->isChecked())
+    return; //and it's hidden during the preview
+  _mapValid = false;
   //qDebug("paintMaks %f %f %f %f", oldPos.x(), oldPos.y(), newPos.x(), newPos.y());
   QPainter painter(&_maskPix);
   if(_resizeWidget.clearRadio->isChecked())
@@ -694,23 +924,12 @@ void MainWindow::changeView(QAction *view)
     _imgItem->setPixmap(QPixmap::fromImage(_img));
     return;
   }
-  CML_color source(_img.width(), _img.height());
-  CML_color dest(_img.width(), _img.height());
+  CML_color source(1, 1);
+  CML_color dest(1, 1);
   QImagetoCML(_img,source);
-  CAIR_convolution conv = V1;
-  switch( _resizeWidget.edgeDetector->currentIndex() )
-  {
-    case 0 : conv = V1; break;
-    case 1 : conv = V_SQUARE; break;
-    case 2 : conv = PREWITT; break;
-    case 3 : conv = SOBEL; break;
-    case 4 : conv = LAPLACIAN; break;
-  }
-  CAIR_energy ener = BACKWARD;
-  if( _resizeWidget.energyCheckBox->isChecked() )
-  {
-    ener = FORWARD;
-  }
+  QImage destImg = newCMLImage(_img.width(), _img.height(), dest);
+  CAIR_convolution conv = convolution();
+  CAIR_energy ener = energy();
   if(view == _viewGreyscale)
     CAIR_Grayscale( &source, &dest );
   if(view == _viewEdge)
@@ -719,7 +938,7 @@ void MainWindow::changeView(QAction *view)
     CAIR_V_Energy( &source, conv, ener, &dest );
   if(view == _viewHEnergy)
     CAIR_H_Energy( &source, conv, ener, &dest );
-  _imgItem->setPixmap(QPixmap::fromImage(CMLtoQImage(dest)));
+  _imgItem->setPixmap(QPixmap::fromImage(CMLtoQImage(dest, destImg)));
 }
 
 void MainWindow::updateView()
@@ -6,6 +6,11 @@
 #include <QMainWindow>
 #include <QPrinter>
 #include <QGraphicsScene>
+#include <QThread>
+#include <QAtomicInt>
+
+#include "cair/CAIR_CML.h"
+#include "cair/CAIR.h"
 
 class QAction;
 class QLabel;
@@ -15,6 +20,8 @@ class QScrollBar;
 class QDockWidget;
 class QGraphicsView;
 class QGraphicsPixmapItem;
+class QProgressBar;
+class QPushButton;
 
 class ImageScene : public QGraphicsScene
 {
@@ -27,12 +34,66 @@ signals:
   void mouseMoved(QPointF oldPos, QPointF newPos);
 };
 
+/// What to carve, filled in before CarveWorker::carve()
+struct CarveJob
+{
+  enum Mode { Resize, ResizeHD, Remove, Map };
+  CarveJob() : weights(1,1) {}
+
+  Mode mode;
+  QImage image;
+  CML_int weights;
+  int goalWidth;
+  int goalHeight;
+  CAIR_convolution conv;
+  CAIR_energy ener;
+  CAIR_direction choice;
+  int attempts;
+  int weightScale;
+};
+
+/// Runs a CarveJob off the GUI thread. Progress comes back through progress(),
+/// and the result is there to pick up once finished() is emitted.
+class CarveWorker : public QThread
+{
+  Q_OBJECT
+public:
+  CarveWorker(QObject *parent=0);
+  ~CarveWorker();
+  void carve();
+  CarveJob &job() { return _job; }
+  QImage result() const { return _result; }
+  CML_int &resultWeights() { return _resultWeights; }
+  CML_int &vMap() { return _vMap; } //from a Map job
+  CML_int &hMap() { return _hMap; }
+  bool wasCanceled() const { return _canceled; } //the last job was stopped before it finished
+public slots:
+  void cancel();
+signals:
+  void progress(int percent);
+protected:
+  void run();
+private:
+  static bool callback(float percDone);
+
+  CAIR_Context *_context;
+  CarveJob _job;
+  QImage _result;
+  CML_int _resultWeights;
+  CML_int _vMap;
+  CML_int _hMap;
+  QAtomicInt _cancelRequested; //set from the GUI thread, read by callback()
+  bool _canceled;
+  int _lastPercent;
+};
+
 class MainWindow : public QMainWindow
 {
 Q_OBJECT
 
 public:
   MainWindow();
+  ~MainWindow();
 
 private slots:
   void open();
@@ -48,6 +109,10 @@ private slots:
   void removeButtonClicked();
   void cairRemove();
   void cairResize(int newWidth, int newHeight);
+  void carveFinished();
+  void togglePreview(bool on);
+  void updatePreview();
+  void invalidatePreview();
   void clearMask();
   void paintMask(QPointF oldPos, QPointF newPos);
   void zoomIn();
@@ -72,6 +137,13 @@ private:
   void adjustScrollBar(QScrollBar *scrollBar, double factor);
   void saveInUndoStack();
   void addToUndoStack();
+  CAIR_convolution convolution();
+  CAIR_energy energy();
+  int weightScale();
+  void maskToWeights(CML_int &weights, int weight_scale);
+  void weightsToMask(CML_int &weights, int weight_scale);
+  void startCarve();
+  void setBusy(bool busy);
 
   QString _filter;
   QImage _img;
@@ -86,6 +158,12 @@ private:
   QVector<QImage> _undoStackImg;
   QVector<QPixmap> _undoStackMask;
   int _undoStackPos;
+  CarveWorker *_worker;
+  QProgressBar *_progressBar;
+  QPushButton *_cancelButton;
+  bool _mapValid;
+  CML_color _previewSource;
+  CML_color _previewDest;
 
   QPrinter _printer;
 
@@ -0,0 +1,960 @@
+//=========================================================================================================//
+//cair-test - checks the CAIR backend against a frozen copy of the CAIR it started from, so no optimization can move a seam.
+//
+//Usage: cair-test [CASES [SEED]]
+//Runs CASES random images (default 60) through the reference and through the current backend, at every SIMD level the CPU
+//has on 1, 2 and 4 threads, and exits with 1 if any gray, edge, energy, seam or pixel differs. What the reference can't do
+//(CAIR_Seams(), CAIR_Removal_Band(), the map files, Attach()) is compared with it where there's a way to, and otherwise checked
+//for what has to hold.
+//=========================================================================================================//
+
+//The reference is the CAIR.cpp, CAIR.h and CAIR_CML.h in reference/, exactly as they were before any of the speedups. Don't
+//touch them, or the check means nothing. They go into their own namespace so both versions fit in one program, which means
+//their system headers have to come in first, outside of it.
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+#include <pthread.h>
+#ifdef __APPLE__
+#include <mach/semaphore.h>
+#include <mach/task.h>
+#else
+#include <semaphore.h>
+#endif
+
+namespace CAIR_Reference
+{
+#include "reference/CAIR.cpp"
+}
+
+//both versions use the same header guards and macros
+#undef CAIR_H
+#undef CAIR_CML_H
+#undef CAIR_NUM_THREADS
+#undef SEM_T
+#undef MIN
+#undef MAX
+#ifdef __APPLE__
+#undef mach_task_self
+#endif
+
+//the stages aren't part of the public interface, so the backend is built right into the test
+#include "../cair/CAIR.cpp"
+
+#include <cstdio>
+
+namespace Ref = CAIR_Reference;
+
+//=========================================================================================================//
+//==                                              C A S E S                                              ==//
+//=========================================================================================================//
+
+unsigned int test_seed = 1;
+
+int Test_Random( int range )
+{
+	test_seed = test_seed * 1664525u + 1013904223u;
+	return (int)( (test_seed >> 8) % (unsigned int)MAX( range, 1 ) );
+}
+
+//=========================================================================================================//
+//One random image, its weights, and everything both versions get asked to do with it.
+struct Test_Case
+{
+	Test_Case() : Image( 1, 1 ), Weights( 1, 1 ), Removal_Weights( 1, 1 ) {}
+
+	CML_color Image;
+	CML_int Weights;
+	CML_int Removal_Weights;
+	CAIR_convolution conv;
+	CAIR_energy ener;
+	int seams; //taken one at a time through the stages
+	bool frontends; //small enough to run CAIR(), CAIR_HD() and CAIR_Removal() too
+	int resize_x, resize_y; //CAIR(), shrinking one way and enlarging the other
+	int hd_x, hd_y; //CAIR_HD()
+	bool removal; //CAIR_Removal() can take its objects out
+	CAIR_direction choice;
+	int attempts;
+	int multi_seams; //CAIR_Seams() for the checks of several seams per map
+	bool maps; //small enough for CAIR_Image_Map(), which takes out nearly every column and row
+	int map_x, map_y; //CAIR_Map_Resize(), against CAIR() taking the same seams
+	int band; //CAIR_Removal_Band()
+};
+
+//=========================================================================================================//
+//A background with some structure to it, so seams have something to avoid.
+void Make_Image( int width, int height, CML_color * Image )
+{
+	(*Image).D_Resize( width, height );
+	bool blocks = Test_Random( 2 ) == 0;
+
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			CML_RGBA pixel;
+			int noise = Test_Random( 64 );
+			if( blocks )
+			{
+				pixel.red = (CML_byte)( ((x/9 + y/7) & 1) * 100 + noise );
+				pixel.green = (CML_byte)( x*5 + noise / 2 );
+				pixel.blue = (CML_byte)( y*9 );
+			}
+			else
+			{
+				bool object = (x - width/3) * (x - width/3) + (y - height/2) * (y - height/2) < (height/5) * (height/5);
+				pixel.red = (CML_byte)( object ? 220 : (x * 200) / width + noise / 16 );
+				pixel.green = (CML_byte)( object ? 40 : (y * 180) / height + noise / 16 );
+				pixel.blue = (CML_byte)( object ? 60 : 120 + noise / 32 );
+			}
+			pixel.alpha = 255;
+			(*Image)(x,y) = pixel;
+		}
+	}
+}
+
+//=========================================================================================================//
+//Draw a whole case from test_seed. The sizes include widths of 1 to 8, and weights pull seams along the sides, where
+//Remove_Quadrant() works SAFE.
+void Make_Case( Test_Case * Case )
+{
+	int width, height;
+	switch( Test_Random( 8 ) )
+	{
+	case 0:
+	case 1:
+		width = 1 + Test_Random( 8 );
+		height = 1 + Test_Random( 40 );
+		break;
+	case 2:
+		width = 9 + Test_Random( 40 );
+		height = 1 + Test_Random( 8 );
+		break;
+	case 3:
+		//enough pixels for the threaded removal and energy maps
+		width = 1040 + Test_Random( 200 );
+		height = 1010 + Test_Random( 50 );
+		break;
+	default:
+		width = 9 + Test_Random( 320 );
+		height = 9 + Test_Random( 250 );
+		break;
+	}
+
+	Make_Image( width, height, &(*Case).Image );
+
+	CML_int * Weights = &(*Case).Weights;
+	(*Weights).D_Resize( width, height );
+	(*Weights).Fill( 0 );
+
+	//a few boxes to protect or remove
+	for( int boxes = Test_Random( 4 ); boxes > 0; boxes-- )
+	{
+		int left = Test_Random( width );
+		int top = Test_Random( height );
+		//MIN() would draw twice
+		int right = left + 1 + Test_Random( width / 8 );
+		int bottom = top + 1 + Test_Random( height / 4 );
+		right = MIN( right, width );
+		bottom = MIN( bottom, height );
+		int weight = ( Test_Random( 2 ) == 0 ) ? -1000 * (1 + Test_Random( 100 )) : 1000 * (1 + Test_Random( 100 ));
+		for( int y = top; y < bottom; y++ )
+		{
+			for( int x = left; x < right; x++ )
+			{
+				(*Weights)(x,y) = weight;
+			}
+		}
+	}
+
+	//and cheap columns near the sides, so some seams run along them
+	if( Test_Random( 2 ) == 0 )
+	{
+		int x = Test_Random( MIN( 5, width ) );
+		if( Test_Random( 2 ) == 0 )
+		{
+			x = width - 1 - x;
+		}
+		for( int y = 0; y < height; y++ )
+		{
+			(*Weights)(x,y) = -50 - Test_Random( 50 );
+		}
+	}
+
+	(*Case).conv = (CAIR_convolution)Test_Random( 5 );
+	(*Case).ener = (CAIR_energy)Test_Random( 2 );
+	(*Case).seams = MIN( width - 1, 3 );
+
+	//the whole thing, on the images small enough to do it quickly
+	(*Case).frontends = (width >= 2) && (height >= 2) && ((long long)width * height <= 120000);
+	(*Case).resize_x = width - Test_Random( width / 3 + 1 );
+	(*Case).resize_y = height + Test_Random( height / 3 + 1 );
+	(*Case).hd_x = width - 1 - Test_Random( width / 3 );
+	(*Case).hd_y = height - 1 - Test_Random( height / 3 );
+
+	//CAIR_Removal() gets weights of its own: small objects that are only a little negative, and a few stray pixels, so an
+	//attempt can leave some of them behind for the next one
+	CML_int * Removal_Weights = &(*Case).Removal_Weights;
+	(*Removal_Weights).D_Resize( width, height );
+	(*Removal_Weights).Fill( 0 );
+	for( int objects = 1 + Test_Random( 2 ); objects > 0; objects-- )
+	{
+		int left = Test_Random( width );
+		int top = Test_Random( height );
+		int right = left + 1 + Test_Random( width / 16 + 1 );
+		int bottom = top + 1 + Test_Random( height / 16 + 1 );
+		right = MIN( right, width );
+		bottom = MIN( bottom, height );
+		int weight = -50 - Test_Random( 64 );
+		for( int y = top; y < bottom; y++ )
+		{
+			for( int x = left; x < right; x++ )
+			{
+				(*Removal_Weights)(x,y) = weight;
+			}
+		}
+	}
+	for( int strays = Test_Random( 3 ); strays > 0; strays-- )
+	{
+		int x = Test_Random( width );
+		(*Removal_Weights)(x,Test_Random( height )) = -3;
+	}
+
+	//CAIR_Add() can't put back more than half of what it has left, and every attempt takes out about as much as the first,
+	//so keep the lot under half the image. The reference also reads past its edges once it gets down to a few pixels across.
+	int negative_x = 0;
+	int negative_y = 0;
+	Count_Negatives( Removal_Weights, &negative_x, &negative_y );
+	(*Case).choice = (CAIR_direction)Test_Random( 3 );
+	(*Case).attempts = 2 + Test_Random( 2 );
+	bool fits_x = negative_x * (*Case).attempts < width / 2;
+	bool fits_y = negative_y * (*Case).attempts < height / 2;
+	(*Case).removal = ((((*Case).choice == VERTICAL) && fits_x) || (((*Case).choice == HORIZONTAL) && fits_y) ||
+					   (((*Case).choice == AUTO) && fits_x && fits_y)) && (width >= 16) && (height >= 16);
+
+	//the settings the reference doesn't have
+	(*Case).multi_seams = 2 + Test_Random( 6 );
+	(*Case).maps = (*Case).frontends && ((long long)width * height <= 12000);
+	int map_min_x = MIN( CAIR_MAP_MIN, width );
+	int map_min_y = MIN( CAIR_MAP_MIN, height );
+	(*Case).map_x = map_min_x + Test_Random( width - map_min_x + 1 );
+	(*Case).map_y = map_min_y + Test_Random( height - map_min_y + 1 );
+	(*Case).band = 1 + Test_Random( 8 );
+}
+
+//=========================================================================================================//
+//==                                                R U N S                                              ==//
+//=========================================================================================================//
+
+//=========================================================================================================//
+//Everything one run of a case produces, so runs can be compared.
+struct Test_Result
+{
+	Test_Result() : gray( 1, 1 ), edge( 1, 1 ), energy( 1, 1 ), paths( 1, 1 ), removed( 1, 1 ), removed_weight( 1, 1 ),
+					resized( 1, 1 ), resized_weight( 1, 1 ), hd( 1, 1 ), hd_weight( 1, 1 ), removal( 1, 1 ), removal_weight( 1, 1 ),
+					v_kept( 1, 1 ), h_kept( 1, 1 )
+	{
+		broken = NULL;
+
+		//whatever a case skips has to compare equal
+		CML_RGBA black = { 0, 0, 0, 0 };
+		removed.Fill( black );
+		resized.Fill( black );
+		hd.Fill( black );
+		removal.Fill( black );
+		removed_weight.Fill( 0 );
+		resized_weight.Fill( 0 );
+		hd_weight.Fill( 0 );
+		removal_weight.Fill( 0 );
+		v_kept.Fill( 0 );
+		h_kept.Fill( 0 );
+	}
+
+	CML_gray gray;
+	CML_int edge;
+	CML_int energy;
+	CML_int paths; //one row per seam taken
+	CML_color removed; //after those seams came out
+	CML_int removed_weight;
+	CML_color resized;
+	CML_int resized_weight;
+	CML_color hd;
+	CML_int hd_weight;
+	CML_color removal;
+	CML_int removal_weight;
+	CML_int v_kept; //the original column of every pixel CAIR_Map_Resize() kept, or CAIR() for the reference
+	CML_int h_kept; //and the original row, for a map in the other direction
+	const char * broken; //the first check of something the reference doesn't have that failed, or NULL
+};
+
+template <typename T>
+bool Same( CML_Matrix<T> * First, CML_Matrix<T> * Second );
+
+//=========================================================================================================//
+//Note a failed check. Only the first is kept, since the rest tend to follow from it.
+void Check( Test_Result * Result, bool ok, const char * what )
+{
+	if( (ok == false) && ((*Result).broken == NULL) )
+	{
+		(*Result).broken = what;
+	}
+}
+
+//=========================================================================================================//
+//Weights that are each pixel's column (or row, with rows), so the weights a resize gives back tell which pixels it kept.
+void Index_Weights( int width, int height, bool rows, CML_int * Weights )
+{
+	(*Weights).D_Resize( width, height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			(*Weights)(x,y) = rows ? y : x;
+		}
+	}
+}
+
+//=========================================================================================================//
+//The same for CAIR_Map_Resize(), which only moves pixels around: the index goes in the red and green.
+void Index_Image( int width, int height, bool rows, CML_color * Image )
+{
+	(*Image).D_Resize( width, height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			int index = rows ? y : x;
+			CML_RGBA pixel = { (CML_byte)(index & 255), (CML_byte)(index >> 8), 0, 0 };
+			(*Image)(x,y) = pixel;
+		}
+	}
+}
+
+void Image_Indices( CML_color * Image, CML_int * Indices )
+{
+	(*Indices).D_Resize( (*Image).Width(), (*Image).Height() );
+	for( int y = 0; y < (*Image).Height(); y++ )
+	{
+		for( int x = 0; x < (*Image).Width(); x++ )
+		{
+			(*Indices)(x,y) = (*Image)(x,y).red | ((*Image)(x,y).green << 8);
+		}
+	}
+}
+
+//=========================================================================================================//
+//CAIR_Seams() has no reference to compare with, so check what has to hold. The seams Energy_Paths() finds are connected and
+//don't share pixels, and the first is the one Energy_Path() finds, which is compared against the reference. Remove_Paths() takes
+//exactly those pixels out of each row, and CAIR() taking several seams per map still keeps the rest of each row in order.
+void Check_Seams( CAIR_Context * context, Test_Case * Case, Test_Result * Result )
+{
+	int width = (*Case).Image.Width();
+	int height = (*Case).Image.Height();
+	int seams = MIN( (*Case).multi_seams, width - 1 );
+	if( seams < 1 )
+	{
+		return;
+	}
+
+	CML_image Source( 1, 1 );
+	Init_CML_Image( &(*Case).Image, &(*Case).Weights, &Source );
+	Grayscale_Image( context, &Source );
+	Edge_Detect( context, &Source, (*Case).conv );
+
+	int * Paths = Scratch_Path( context, 0, seams * height );
+	int found = Energy_Paths( context, &Source, Paths, seams, (*Case).ener );
+	Check( Result, (found >= 1) && (found <= seams), "Energy_Paths() seam count" );
+	if( (found < 1) || (found > seams) )
+	{
+		return;
+	}
+
+	CML_int Taken( width, height );
+	Taken.Fill( 0 );
+	for( int s = 0; s < found; s++ )
+	{
+		for( int y = 0; y < height; y++ )
+		{
+			int x = Paths[y*found + s];
+			bool inside = (x >= 0) && (x < width);
+			Check( Result, inside, "Energy_Paths() seam inside the image" );
+			if( inside == false )
+			{
+				return;
+			}
+			Check( Result, (y == 0) || (abs( x - Paths[(y-1)*found + s] ) <= 1), "Energy_Paths() seam connected" );
+			Check( Result, Taken(x,y) == 0, "Energy_Paths() seams apart" );
+			Taken(x,y) = 1;
+			Check( Result, (s > 0) || (x == (*Result).paths(y,0)), "Energy_Paths() first seam is Energy_Path()'s" );
+		}
+	}
+
+	//what Remove_Paths() has to leave of the weights, which it doesn't blend
+	CML_int Expected( width - found, height );
+	for( int y = 0; y < height; y++ )
+	{
+		int kept = 0;
+		for( int x = 0; x < width; x++ )
+		{
+			if( Taken(x,y) == 0 )
+			{
+				Expected(kept++,y) = Source.weight(x,y);
+			}
+		}
+	}
+	Remove_Paths( context, &Source, Paths, found, (*Case).conv );
+	Check( Result, Same( &Expected, &Source.weight ), "Remove_Paths() weights" );
+
+	if( (*Case).frontends == false )
+	{
+		return;
+	}
+	CML_int Index( 1, 1 );
+	Index_Weights( width, height, false, &Index );
+	CML_color Dest( 1, 1 );
+	CML_int D_Weights( 1, 1 );
+	CAIR_Seams( context, ((*Case).multi_seams == 7) ? CAIR_ADAPTIVE_SEAMS : (*Case).multi_seams );
+	CAIR( context, &(*Case).Image, &Index, (*Case).map_x, height, (*Case).conv, (*Case).ener, &D_Weights, &Dest, NULL );
+	CAIR_Seams( context, 1 );
+
+	bool ordered = (D_Weights.Width() == (*Case).map_x) && (D_Weights.Height() == height);
+	for( int y = 0; ordered && (y < height); y++ )
+	{
+		for( int x = 1; x < (*Case).map_x; x++ )
+		{
+			ordered = ordered && (D_Weights(x-1,y) < D_Weights(x,y));
+		}
+	}
+	Check( Result, ordered, "CAIR() with CAIR_Seams() keeps each row in order" );
+}
+
+//=========================================================================================================//
+//CAIR_Image_Map() takes the same seams CAIR() does, so the pixels CAIR_Map_Resize() keeps are the ones CAIR() keeps, which the
+//reference can tell through its weights. The maps also go through a map file and come back the same.
+void Check_Maps( CAIR_Context * context, Test_Case * Case, Test_Result * Result )
+{
+	int width = (*Case).Image.Width();
+	int height = (*Case).Image.Height();
+	CML_int Index( 1, 1 );
+	CML_int V_Map( 1, 1 );
+	CML_int H_Map( 1, 1 );
+	CML_color Indices( 1, 1 );
+	CML_color Resized( 1, 1 );
+
+	Index_Weights( width, height, false, &Index );
+	CAIR_Image_Map( context, &(*Case).Image, &Index, (*Case).conv, (*Case).ener, &V_Map, NULL, NULL );
+	Index_Image( width, height, false, &Indices );
+	CAIR_Map_Resize( &Indices, &V_Map, NULL, (*Case).map_x, height, &Resized );
+	Image_Indices( &Resized, &(*Result).v_kept );
+
+	Index_Weights( width, height, true, &Index );
+	CAIR_Image_Map( context, &(*Case).Image, &Index, (*Case).conv, (*Case).ener, &V_Map, &H_Map, NULL );
+	Index_Image( width, height, true, &Indices );
+	CAIR_Map_Resize( &Indices, &V_Map, &H_Map, width, (*Case).map_y, &Resized );
+	Image_Indices( &Resized, &(*Result).h_kept );
+
+	//both ways at once has nothing to compare with, but each row still has to keep its columns in order
+	CML_color Columns( 1, 1 );
+	CML_int Kept( 1, 1 );
+	Index_Image( width, height, false, &Columns );
+	CAIR_Map_Resize( &Columns, &V_Map, &H_Map, (*Case).map_x, (*Case).map_y, &Resized );
+	Image_Indices( &Resized, &Kept );
+	bool ordered = (Kept.Width() == (*Case).map_x) && (Kept.Height() == (*Case).map_y);
+	for( int y = 0; ordered && (y < Kept.Height()); y++ )
+	{
+		for( int x = 1; x < Kept.Width(); x++ )
+		{
+			ordered = ordered && (Kept(x-1,y) < Kept(x,y));
+		}
+	}
+	Check( Result, ordered, "CAIR_Map_Resize() both ways keeps each row in order" );
+	Index_Image( width, height, true, &Indices );
+	CAIR_Map_Resize( &Indices, &V_Map, &H_Map, width, (*Case).map_y, &Resized );
+
+	//and through a file
+	const char * filename = "cair-test.map";
+	CML_int Loaded_V( 1, 1 );
+	CML_int Loaded_H( 1, 1 );
+	CAIR_Map_Info Info;
+	bool saved = CAIR_Save_Map( filename, &(*Case).Image, &V_Map, &H_Map, (*Case).conv, (*Case).ener );
+	bool loaded = saved && CAIR_Load_Map( filename, &(*Case).Image, &Loaded_V, &Loaded_H, &Info );
+	Check( Result, loaded, "CAIR_Save_Map() then CAIR_Load_Map()" );
+	if( loaded == true )
+	{
+		Check( Result, Same( &V_Map, &Loaded_V ) && Same( &H_Map, &Loaded_H ), "CAIR_Load_Map() maps" );
+		Check( Result, (Info.version == CAIR_MAP_VERSION) && (Info.width == width) && (Info.height == height) &&
+					   (Info.conv == (*Case).conv) && (Info.ener == (*Case).ener) && (Info.has_h_map == true) &&
+					   (Info.source_hash == CAIR_Image_Hash( &(*Case).Image )), "CAIR_Load_Map() header" );
+
+		CML_color Loaded_Resized( 1, 1 );
+		CAIR_Map_Resize( &Indices, &Loaded_V, &Loaded_H, width, (*Case).map_y, &Loaded_Resized );
+		Check( Result, Same( &Resized, &Loaded_Resized ), "CAIR_Map_Resize() from a loaded map" );
+
+		//the map is only for the image it was made from
+		CML_color Other( 1, 1 );
+		Other = (*Case).Image;
+		Other(width/2,height/2).red ^= 1;
+		Check( Result, CAIR_Load_Map( filename, &Other, &Loaded_V, &Loaded_H, NULL ) == false, "CAIR_Load_Map() of another image" );
+	}
+	remove( filename );
+}
+
+//=========================================================================================================//
+//A band that covers the whole image has to find the same seams as no band, which is checked against the reference. That's only
+//with backward energy: without a band the map is updated around each seam, which isn't exact with forward energy, while the band
+//map is built fresh every time. A narrow band still has to give back an image of the original size.
+void Check_Removal_Band( CAIR_Context * context, Test_Case * Case, Test_Result * Result )
+{
+	int width = (*Case).Image.Width();
+	int height = (*Case).Image.Height();
+	CML_color Dest( 1, 1 );
+	CML_int D_Weights( 1, 1 );
+
+	if( (*Case).ener == BACKWARD )
+	{
+		CAIR_Removal_Band( context, width + height );
+		CAIR_Removal( context, &(*Case).Image, &(*Case).Removal_Weights, (*Case).choice, (*Case).attempts, (*Case).conv, (*Case).ener,
+					  &D_Weights, &Dest, NULL );
+		Check( Result, Same( &Dest, &(*Result).removal ) && Same( &D_Weights, &(*Result).removal_weight ),
+			   "CAIR_Removal_Band() over the whole image" );
+	}
+
+	CAIR_Removal_Band( context, (*Case).band );
+	CAIR_Removal( context, &(*Case).Image, &(*Case).Removal_Weights, (*Case).choice, (*Case).attempts, (*Case).conv, (*Case).ener,
+				  &D_Weights, &Dest, NULL );
+	CAIR_Removal_Band( context, 0 );
+	Check( Result, (Dest.Width() == width) && (Dest.Height() == height) && (D_Weights.Width() == width) && (D_Weights.Height() == height),
+		   "CAIR_Removal_Band() size" );
+}
+
+//=========================================================================================================//
+//Run one case through the current stages and frontends.
+void Run_Case( CAIR_Context * context, Test_Case * Case, Test_Result * Result )
+{
+	int width = (*Case).Image.Width();
+	int height = (*Case).Image.Height();
+
+	CML_image Source( 1, 1 );
+	Init_CML_Image( &(*Case).Image, &(*Case).Weights, &Source );
+	Grayscale_Image( context, &Source );
+	(*Result).gray = Source.gray;
+	Edge_Detect( context, &Source, (*Case).conv );
+	(*Result).edge = Source.edge;
+
+	//a few seams, the way CAIR_Remove() takes them
+	(*Result).paths.D_Resize( height, (*Case).seams + 1 );
+	int * Path = Scratch_Path( context, 0, height );
+	for( int i = 0; i <= (*Case).seams; i++ )
+	{
+		Energy_Path( context, &Source, Path, (*Case).ener, i == 0 );
+		if( i == 0 )
+		{
+			(*Result).energy = Source.energy;
+		}
+		for( int y = 0; y < height; y++ )
+		{
+			(*Result).paths(y,i) = Path[y];
+		}
+		if( i < (*Case).seams )
+		{
+			Remove_Path( context, &Source, Path, (*Case).conv );
+		}
+	}
+	(*Result).removed = Source.image;
+	(*Result).removed_weight = Source.weight;
+	Check_Seams( context, Case, Result );
+
+	if( (*Case).frontends == false )
+	{
+		return;
+	}
+
+	//the first resize reads and writes memory given to it with Attach(), with padded rows, the way the GUI hands over a QImage
+	int source_stride = width + 3;
+	int dest_stride = MAX( (*Case).resize_x, width ) + 5;
+	CML_RGBA padding = { 0x5a, 0xa5, 0x5a, 0xa5 };
+	CML_RGBA * source_pixels = new CML_RGBA[source_stride * height];
+	CML_RGBA * dest_pixels = new CML_RGBA[dest_stride * (*Case).resize_y];
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < source_stride; x++ )
+		{
+			source_pixels[y*source_stride + x] = ( x < width ) ? (*Case).Image(x,y) : padding;
+		}
+	}
+	{
+		CML_color Attached_Source( 1, 1 );
+		CML_color Attached_Dest( 1, 1 );
+		Attached_Source.Attach( source_pixels, width, height, source_stride );
+		Attached_Dest.Attach( dest_pixels, (*Case).resize_x, (*Case).resize_y, dest_stride );
+		CAIR( context, &Attached_Source, &(*Case).Weights, (*Case).resize_x, (*Case).resize_y, (*Case).conv, (*Case).ener,
+			  &(*Result).resized_weight, &Attached_Dest, NULL );
+		Check( Result, Attached_Dest.Row( 0 ) == dest_pixels, "CAIR() into Attach()'ed memory that fits" );
+		Check( Result, Same( &Attached_Source, &(*Case).Image ) && (memcmp( &source_pixels[width], &padding, sizeof(padding) ) == 0),
+			   "CAIR() leaves an Attach()'ed Source alone" );
+		(*Result).resized = Attached_Dest;
+	}
+	delete[] source_pixels;
+	delete[] dest_pixels;
+
+	CAIR( context, &(*Result).resized, &(*Result).resized_weight, width, height, (*Case).conv, (*Case).ener,
+		  &(*Result).resized_weight, &(*Result).resized, NULL );
+
+	//CAIR_HD() into Attach()'ed memory with no room to spare, which is all the GUI gives it
+	CML_RGBA * hd_pixels = new CML_RGBA[(*Case).hd_x * (*Case).hd_y];
+	{
+		CML_color Attached_Dest( 1, 1 );
+		Attached_Dest.Attach( hd_pixels, (*Case).hd_x, (*Case).hd_y, (*Case).hd_x );
+		CAIR_HD( context, &(*Case).Image, &(*Case).Weights, (*Case).hd_x, (*Case).hd_y, (*Case).conv, (*Case).ener,
+				 &(*Result).hd_weight, &Attached_Dest, NULL );
+		Check( Result, Attached_Dest.Row( 0 ) == hd_pixels, "CAIR_HD() into Attach()'ed memory that fits" );
+		(*Result).hd = Attached_Dest;
+	}
+	delete[] hd_pixels;
+	if( (*Case).removal == true )
+	{
+		CAIR_Removal( context, &(*Case).Image, &(*Case).Removal_Weights, (*Case).choice, (*Case).attempts, (*Case).conv, (*Case).ener,
+					  &(*Result).removal_weight, &(*Result).removal, NULL );
+		Check_Removal_Band( context, Case, Result );
+	}
+	if( (*Case).maps == true )
+	{
+		Check_Maps( context, Case, Result );
+	}
+}
+
+//=========================================================================================================//
+//Copies between the two versions' matrices. Their pixels have the same fields, but they're different types.
+void To_Reference( CML_color * Source, Ref::CML_color * Dest )
+{
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	for( int y = 0; y < (*Source).Height(); y++ )
+	{
+		for( int x = 0; x < (*Source).Width(); x++ )
+		{
+			(*Dest)(x,y).red = (*Source)(x,y).red;
+			(*Dest)(x,y).green = (*Source)(x,y).green;
+			(*Dest)(x,y).blue = (*Source)(x,y).blue;
+			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+		}
+	}
+}
+
+void To_Reference( CML_int * Source, Ref::CML_int * Dest )
+{
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	for( int y = 0; y < (*Source).Height(); y++ )
+	{
+		for( int x = 0; x < (*Source).Width(); x++ )
+		{
+			(*Dest)(x,y) = (*Source)(x,y);
+		}
+	}
+}
+
+void From_Reference( Ref::CML_color * Source, CML_color * Dest )
+{
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	for( int y = 0; y < (*Source).Height(); y++ )
+	{
+		for( int x = 0; x < (*Source).Width(); x++ )
+		{
+			(*Dest)(x,y).red = (*Source)(x,y).red;
+			(*Dest)(x,y).green = (*Source)(x,y).green;
+			(*Dest)(x,y).blue = (*Source)(x,y).blue;
+			(*Dest)(x,y).alpha = (*Source)(x,y).alpha;
+		}
+	}
+}
+
+void From_Reference( Ref::CML_int * Source, CML_int * Dest )
+{
+	(*Dest).D_Resize( (*Source).Width(), (*Source).Height() );
+	for( int y = 0; y < (*Source).Height(); y++ )
+	{
+		for( int x = 0; x < (*Source).Width(); x++ )
+		{
+			(*Dest)(x,y) = (*Source)(x,y);
+		}
+	}
+}
+
+//=========================================================================================================//
+//Run one case through the reference, step for step the way Run_Case() does.
+void Run_Reference( Test_Case * Case, Test_Result * Result )
+{
+	int width = (*Case).Image.Width();
+	int height = (*Case).Image.Height();
+	Ref::CAIR_convolution conv = (Ref::CAIR_convolution)(*Case).conv;
+	Ref::CAIR_energy ener = (Ref::CAIR_energy)(*Case).ener;
+
+	Ref::CML_color Image( 1, 1 );
+	Ref::CML_int Weights( 1, 1 );
+	To_Reference( &(*Case).Image, &Image );
+	To_Reference( &(*Case).Weights, &Weights );
+
+	Ref::CML_image Source( width, height );
+	Ref::CML_image_ptr Source_ptr( width, height );
+	Ref::Init_CML_Image( &Image, &Weights, &Source, &Source_ptr );
+
+	//the stages need the reference's threads, which its frontends start for themselves
+	Ref::Startup_Threads();
+	Ref::Grayscale_Image( &Source_ptr );
+	(*Result).gray.D_Resize( width, height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			(*Result).gray(x,y) = Source_ptr(x,y)->gray;
+		}
+	}
+	Ref::Edge_Detect( &Source_ptr, conv );
+	(*Result).edge.D_Resize( width, height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			(*Result).edge(x,y) = Source_ptr(x,y)->edge;
+		}
+	}
+
+	(*Result).paths.D_Resize( height, (*Case).seams + 1 );
+	int * Path = new int[height];
+	for( int i = 0; i <= (*Case).seams; i++ )
+	{
+		Ref::Energy_Path( &Source_ptr, Path, ener, i == 0 );
+		if( i == 0 )
+		{
+			(*Result).energy.D_Resize( width, height );
+			for( int y = 0; y < height; y++ )
+			{
+				for( int x = 0; x < width; x++ )
+				{
+					(*Result).energy(x,y) = Source_ptr(x,y)->energy;
+				}
+			}
+		}
+		for( int y = 0; y < height; y++ )
+		{
+			(*Result).paths(y,i) = Path[y];
+		}
+		if( i < (*Case).seams )
+		{
+			Ref::Remove_Path( &Source_ptr, Path, conv );
+		}
+	}
+	delete[] Path;
+	Ref::Shutdown_Threads();
+
+	Ref::CML_color Dest( 1, 1 );
+	Ref::CML_int D_Weights( 1, 1 );
+	Ref::Extract_CML_Image( &Source_ptr, &Dest, &D_Weights );
+	From_Reference( &Dest, &(*Result).removed );
+	From_Reference( &D_Weights, &(*Result).removed_weight );
+
+	if( (*Case).frontends == false )
+	{
+		return;
+	}
+	Ref::CAIR( &Image, &Weights, (*Case).resize_x, (*Case).resize_y, conv, ener, &D_Weights, &Dest, NULL );
+	Ref::CAIR( &Dest, &D_Weights, width, height, conv, ener, &D_Weights, &Dest, NULL );
+	From_Reference( &Dest, &(*Result).resized );
+	From_Reference( &D_Weights, &(*Result).resized_weight );
+
+	Ref::CAIR_HD( &Image, &Weights, (*Case).hd_x, (*Case).hd_y, conv, ener, &D_Weights, &Dest, NULL );
+	From_Reference( &Dest, &(*Result).hd );
+	From_Reference( &D_Weights, &(*Result).hd_weight );
+
+	//what CAIR_Map_Resize() has to keep
+	if( (*Case).maps == true )
+	{
+		CML_int Index( 1, 1 );
+		Ref::CML_int Ref_Index( 1, 1 );
+		Index_Weights( width, height, false, &Index );
+		To_Reference( &Index, &Ref_Index );
+		Ref::CAIR( &Image, &Ref_Index, (*Case).map_x, height, conv, ener, &D_Weights, &Dest, NULL );
+		From_Reference( &D_Weights, &(*Result).v_kept );
+		Index_Weights( width, height, true, &Index );
+		To_Reference( &Index, &Ref_Index );
+		Ref::CAIR( &Image, &Ref_Index, width, (*Case).map_y, conv, ener, &D_Weights, &Dest, NULL );
+		From_Reference( &D_Weights, &(*Result).h_kept );
+	}
+
+	if( (*Case).removal == true )
+	{
+		To_Reference( &(*Case).Removal_Weights, &Weights );
+		Ref::CAIR_Removal( &Image, &Weights, (Ref::CAIR_direction)(*Case).choice, (*Case).attempts, conv, ener, &D_Weights, &Dest, NULL );
+		From_Reference( &Dest, &(*Result).removal );
+		From_Reference( &D_Weights, &(*Result).removal_weight );
+	}
+}
+
+//=========================================================================================================//
+//The reference's Energy_Map() reads past the row on images one pixel wide. Two copies of the column side by side have the same
+//neighbors all around, since the kernels repeat the edge pixels, so the reference runs on that and the first column is kept.
+void Run_Reference_Narrow( Test_Case * Case, Test_Result * Result )
+{
+	int height = (*Case).Image.Height();
+	Test_Case Doubled;
+	Doubled.Image.D_Resize( 2, height );
+	Doubled.Weights.D_Resize( 2, height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < 2; x++ )
+		{
+			Doubled.Image(x,y) = (*Case).Image(0,y);
+			Doubled.Weights(x,y) = (*Case).Weights(0,y);
+		}
+	}
+	Doubled.conv = (*Case).conv;
+	Doubled.ener = (*Case).ener;
+	Doubled.seams = 0;
+	Doubled.frontends = false;
+
+	Run_Reference( &Doubled, Result );
+	(*Result).gray.Resize_Width( 1 );
+	(*Result).edge.Resize_Width( 1 );
+	(*Result).energy.Resize_Width( 1 );
+	(*Result).removed.Resize_Width( 1 );
+	(*Result).removed_weight.Resize_Width( 1 );
+}
+
+//=========================================================================================================//
+//==                                            C O M P A R E                                            ==//
+//=========================================================================================================//
+
+//=========================================================================================================//
+//Same size and the same values in every element.
+template <typename T>
+bool Same( CML_Matrix<T> * First, CML_Matrix<T> * Second )
+{
+	if( ((*First).Width() != (*Second).Width()) || ((*First).Height() != (*Second).Height()) )
+	{
+		return false;
+	}
+	for( int y = 0; y < (*First).Height(); y++ )
+	{
+		if( memcmp( (*First).Row(y), (*Second).Row(y), (*First).Width() * sizeof(T) ) != 0 )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//=========================================================================================================//
+//Compare a run against the reference, reporting what differs. Returns how many parts did.
+int Compare( Test_Result * Reference, Test_Result * Result, const char * description )
+{
+	const char * names[14] = { "Grayscale_Image", "Edge_Detect", "Energy_Map", "seams", "Remove_Path image", "Remove_Path weights",
+							   "CAIR image", "CAIR weights", "CAIR_HD image", "CAIR_HD weights", "CAIR_Removal image", "CAIR_Removal weights",
+							   "CAIR_Map_Resize columns", "CAIR_Map_Resize rows" };
+	bool same[14] = { Same( &(*Reference).gray, &(*Result).gray ), Same( &(*Reference).edge, &(*Result).edge ),
+					  Same( &(*Reference).energy, &(*Result).energy ), Same( &(*Reference).paths, &(*Result).paths ),
+					  Same( &(*Reference).removed, &(*Result).removed ), Same( &(*Reference).removed_weight, &(*Result).removed_weight ),
+					  Same( &(*Reference).resized, &(*Result).resized ), Same( &(*Reference).resized_weight, &(*Result).resized_weight ),
+					  Same( &(*Reference).hd, &(*Result).hd ), Same( &(*Reference).hd_weight, &(*Result).hd_weight ),
+					  Same( &(*Reference).removal, &(*Result).removal ), Same( &(*Reference).removal_weight, &(*Result).removal_weight ),
+					  Same( &(*Reference).v_kept, &(*Result).v_kept ), Same( &(*Reference).h_kept, &(*Result).h_kept ) };
+
+	int failures = 0;
+	for( int i = 0; i < 14; i++ )
+	{
+		if( same[i] == false )
+		{
+			fprintf( stderr, "MISMATCH %s: %s\n", description, names[i] );
+			failures++;
+		}
+	}
+	if( (*Result).broken != NULL )
+	{
+		fprintf( stderr, "MISMATCH %s: check of %s\n", description, (*Result).broken );
+		failures++;
+	}
+	return failures;
+}
+
+//=========================================================================================================//
+int main( int argc, char * argv[] )
+{
+	int cases = 60;
+	unsigned int seed = 1;
+	if( argc > 1 )
+	{
+		cases = atoi( argv[1] );
+	}
+	if( argc > 2 )
+	{
+		seed = (unsigned int)strtoul( argv[2], NULL, 10 );
+	}
+	if( (argc > 3) || (cases < 1) )
+	{
+		fprintf( stderr, "Usage: %s [CASES [SEED]]\n", argv[0] );
+		return 1;
+	}
+
+	const char * conv_names[5] = { "PREWITT", "V1", "V_SQUARE", "SOBEL", "LAPLACIAN" };
+	const char * ener_names[2] = { "BACKWARD", "FORWARD" };
+	const int thread_counts[3] = { 1, 2, 4 };
+	CAIR_simd best = Detect_SIMD();
+	int failures = 0;
+	int compares = 0;
+
+	//the reference's workers share their start semaphores, so with more than one a worker can take another's strip along with
+	//its own, and leave that strip undone. One thread is what it gives when that doesn't happen.
+	Ref::CAIR_Threads( 1 );
+
+	CAIR_Context * contexts[3];
+	for( int t = 0; t < 3; t++ )
+	{
+		contexts[t] = CAIR_Create_Context( thread_counts[t] );
+		Startup_Threads( contexts[t] );
+	}
+
+	test_seed = seed;
+	for( int i = 0; i < cases; i++ )
+	{
+		Test_Case Case;
+		Make_Case( &Case );
+		int width = Case.Image.Width();
+		int height = Case.Image.Height();
+		fprintf( stderr, "case %d: %dx%d, %s %s\n", i, width, height, conv_names[Case.conv], ener_names[Case.ener] );
+
+		Test_Result Reference;
+		if( width > 1 )
+		{
+			Run_Reference( &Case, &Reference );
+		}
+		else
+		{
+			Run_Reference_Narrow( &Case, &Reference );
+		}
+
+		for( int level = CAIR_SCALAR; level <= best; level++ )
+		{
+			CAIR_Set_SIMD( (CAIR_simd)level );
+			for( int t = 0; t < 3; t++ )
+			{
+				Test_Result Result;
+				Run_Case( contexts[t], &Case, &Result );
+
+				char description[160];
+				sprintf( description, "case %d (%dx%d, %s %s, seed %u), %s on %d threads", i, width, height,
+						 conv_names[Case.conv], ener_names[Case.ener], seed, CAIR_SIMD_Name( (CAIR_simd)level ), thread_counts[t] );
+				failures += Compare( &Reference, &Result, description );
+				compares++;
+			}
+		}
+	}
+
+	for( int t = 0; t < 3; t++ )
+	{
+		CAIR_Destroy_Context( contexts[t] );
+	}
+	CAIR_Set_SIMD( best );
+
+	printf( "%d cases, seed %u, %d runs compared against the reference up to %s: %d mismatches\n",
+			cases, seed, compares, CAIR_SIMD_Name( best ), failures );
+	return ( failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+# Checks the CAIR backend against the original CAIR in reference/. You can make this with
+# qmake cair-test.pro
+# and run it with
+# make check
+# which fails if any seam or pixel differs. ./cair-test CASES SEED runs more, or other, random images.
+
+TEMPLATE = app
+TARGET = cair-test
+CONFIG += console release testcase
+CONFIG -= qt app_bundle
+
+#Because the c files have c++ like sytax
+!win32:QMAKE_CC = g++
+
+# cair-test.cpp includes both versions of CAIR.cpp itself, so it can get at the stages
+INCLUDEPATH += ../cair
+
+HEADERS += \
+	   ../cair/CAIR.h \
+	   ../cair/CAIR_CML.h \
+	   reference/CAIR.h \
+	   reference/CAIR_CML.h
+
+SOURCES += cair-test.cpp
+
+win32{
+#use the pthreads lib
+DEFINES += PTHREADS_WINDOWS
+INCLUDEPATH += ../cair/pthreads
+LIBS += ..\cair\pthreads\pthreadVSE2.lib
+}
+!win32{
+LIBS += -lpthread
+}